@@ -53,12 +53,15 @@
 #define UTIL_WEIGHT .60
 
 /*
- * Alignment requirement in bytes (either 4 or 8)
+ * Alignment requirement in bytes (8 or 16). Build with
+ * "make MMFLAGS=-DALIGNMENT=16" to test 16-byte alignment.
  */
+#ifndef ALIGNMENT
 #define ALIGNMENT 8
+#endif
 
 /*
- * Maximum heap size in bytes
+ * Maximum heap size in bytes, unless mdriver -m or MM_HEAP_MAX sets another
  */
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
 
@@ -31,7 +31,7 @@
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
 
 /* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
+#define IS_ALIGNED(p)  ((((size_t)(p)) % ALIGNMENT) == 0)
 
 /****************************** 
  * The key compound data types 
@@ -81,6 +81,9 @@ typedef struct {
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    double slack;    /* most realloc slack held, as a fraction of the heap */
+    int counted;     /* did mm_stats fill in counters? */
+    mm_stats_t counters; /* the allocator's counters after the util run */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
@@ -100,6 +103,22 @@ static char *default_tracefiles[] = {
     DEFAULT_TRACEFILES, NULL
 };
 
+/* The placement policies compared by -p */
+typedef struct {
+    char *name;       /* column heading */
+    int fit;          /* MM_FIT_POLICY value */
+    size_t split;     /* MM_SPLIT_HIGH value */
+} policy_t;
+
+static policy_t policies[] = {
+    {"best",    MM_FIT_BEST,    200},
+    {"first",   MM_FIT_FIRST,   200},
+    {"next",    MM_FIT_NEXT,    200},
+    {"address", MM_FIT_ADDRESS, 200},
+    {"nosplit", MM_FIT_BEST,    (size_t)-1},
+};
+#define NUM_POLICIES ((int)(sizeof(policies) / sizeof(policy_t)))
+
 
 /********************* 
  * Function prototypes 
@@ -122,11 +141,15 @@ static void eval_libc_speed(void *ptr);
 /* Routines for evaluating correctnes, space utilization, and speed 
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   double *slack);
 static void eval_mm_speed(void *ptr);
+static void eval_mm(char **tracefiles, int n, stats_t *stats);
+static void compare_policies(char **tracefiles, int n);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printstats(int n, stats_t *stats);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -142,7 +165,6 @@ int main(int argc, char **argv)
     char **tracefiles = NULL;  /* null-terminated array of trace file names */
     int num_tracefiles = 0;    /* the number of traces in that array */
     trace_t *trace = NULL;     /* stores a single trace file in memory */
-    range_t *ranges = NULL;    /* keeps track of block extents for one trace */
     stats_t *libc_stats = NULL;/* libc stats for each trace */
     stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
     speed_t speed_params;      /* input parameters to the xx_speed routines */ 
@@ -150,6 +172,10 @@ int main(int argc, char **argv)
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    int compare = 0;     /* If set, compare the fit policies (set by -p) */
+    size_t heap_max = 0; /* If set, bytes memlib reserves for the heap (-m) */
+    char *end;
+    int shift;
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -158,7 +184,7 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:m:hvVgalp")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
@@ -178,12 +204,37 @@ int main(int argc, char **argv)
 	    if (tracedir[strlen(tracedir)-1] != '/') 
 		strcat(tracedir, "/"); /* path always ends with "/" */
 	    break;
+        case 'm': /* Heap reservation, in bytes or with a K, M or G suffix */
+	    errno = 0;
+	    heap_max = strtoul(optarg, &end, 0);
+	    shift = 0;
+	    switch (*end) {
+	    case 'G': case 'g': shift += 10; /* fall through */
+	    case 'M': case 'm': shift += 10; /* fall through */
+	    case 'K': case 'k': shift += 10; end++; break;
+	    }
+	    if (end == optarg || *end != '\0') {
+		usage();
+		exit(1);
+	    }
+	    /* The allocator checks the size against what it can address */
+	    if (errno == ERANGE || heap_max > ((size_t)-1 >> shift) ||
+		mm_setopt(MM_HEAP_MAX, heap_max << shift) < 0) {
+		fprintf(stderr, "mdriver: heap size %s is more than the allocator can use\n",
+			optarg);
+		exit(1);
+	    }
+	    heap_max <<= shift;
+	    break;
         case 'a': /* Don't check team structure */
             team_check = 0;
             break;
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
+        case 'p': /* Compare the fit policies */
+            compare = 1;
+            break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = 1;
             break;
@@ -286,31 +337,17 @@ int main(int argc, char **argv)
     
     /* Initialize the simulated memory system in memlib.c */
     mem_init(); 
+    if (heap_max != 0 && mem_reserve(heap_max) < 0)
+	unix_error("mem_reserve failed in main");
 
     /* Evaluate student's mm malloc package using the K-best scheme */
-    for (i=0; i < num_tracefiles; i++) {
-	trace = read_trace(tracedir, tracefiles[i]);
-	mm_stats[i].ops = trace->num_ops;
-	if (verbose > 1)
-	    printf("Checking mm_malloc for correctness, ");
-	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-	if (mm_stats[i].valid) {
-	    if (verbose > 1)
-		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-	    speed_params.trace = trace;
-	    speed_params.ranges = ranges;
-	    if (verbose > 1)
-		printf("and performance.\n");
-	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-	}
-	free_trace(trace);
-    }
+    eval_mm(tracefiles, num_tracefiles, mm_stats);
 
     /* Display the mm results in a compact table */
     if (verbose) {
 	printf("\nResults for mm malloc:\n");
 	printresults(num_tracefiles, mm_stats);
+	printstats(num_tracefiles, mm_stats);
 	printf("\n");
     }
 
@@ -330,6 +367,12 @@ int main(int argc, char **argv)
     }
     avg_mm_util = util/num_tracefiles;
 
+    /* Report what backed the heap, if memlib was built for huge pages */
+    if (mem_hugepagesize() != 0)
+	printf("Huge pages backing the heap: %lu of %luKB\n",
+	       (unsigned long)mem_hugepages(),
+	       (unsigned long)mem_hugepagesize() / 1024);
+
     /* 
      * Compute and print the performance index 
      */
@@ -362,6 +405,12 @@ int main(int argc, char **argv)
 	printf("perfidx:%.0f\n", perfindex);
     }
 
+    /*
+     * Optionally rerun the traces under each fit policy
+     */
+    if (compare)
+	compare_policies(tracefiles, num_tracefiles);
+
     exit(0);
 }
 
@@ -395,9 +444,11 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of the heap, or of one
+       region the allocator mapped for it */
+    if (((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
+	 (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) &&
+	!mem_mapped_range(lo, hi)) {
 	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
 		lo, hi, mem_heap_lo(), mem_heap_hi());
 	malloc_error(tracenum, opnum, msg);
@@ -689,19 +740,21 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   The idea is to remember the high water mark "hwm" of the heap for 
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the 
- *   size of the heap in bytes after running the student's malloc 
- *   package on the trace. Note that our implementation of mem_sbrk() 
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap. 
+ *   most memory (heap plus regions from mem_map) the student's malloc
+ *   package held at once while running the trace, as recorded by
+ *   mem_peaksize(). The most slack mm_realloc reserved at once
+ *   (mm_grow_slack()) is returned in *slack as a share of the same.
  *   
  */
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   double *slack)
 {   
     int i;
     int index;
     int size, newsize, oldsize;
     int max_total_size = 0;
     int total_size = 0;
+    size_t max_slack = 0;
     char *p;
     char *newp, *oldp;
 
@@ -753,6 +806,8 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Update statistics */
 	    max_total_size = (total_size > max_total_size) ?
 		total_size : max_total_size;
+	    max_slack = (mm_grow_slack() > max_slack) ?
+		mm_grow_slack() : max_slack;
 	    break;
 
         case FREE: /* mm_free */
@@ -774,7 +829,8 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
         }
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    *slack = (double)max_slack / (double)mem_peaksize();
+    return ((double)max_total_size / (double)mem_peaksize());
 }
 
 
@@ -825,6 +881,105 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+/*
+ * eval_mm - Evaluate the mm malloc package on each of the n traces in
+ *     tracefiles, filling in stats[i] for trace i
+ */
+static void eval_mm(char **tracefiles, int n, stats_t *stats)
+{
+    int i;
+    trace_t *trace;
+    range_t *ranges = NULL;
+    speed_t speed_params;
+
+    for (i=0; i < n; i++) {
+	trace = read_trace(tracedir, tracefiles[i]);
+	stats[i].ops = trace->num_ops;
+	if (verbose > 1)
+	    printf("Checking mm_malloc for correctness, ");
+	stats[i].valid = eval_mm_valid(trace, i, &ranges);
+	if (stats[i].valid) {
+	    if (verbose > 1)
+		printf("efficiency, ");
+	    stats[i].util = eval_mm_util(trace, i, &ranges,
+					 &stats[i].slack);
+	    stats[i].counted = (mm_stats(&stats[i].counters) == 0);
+	    speed_params.trace = trace;
+	    speed_params.ranges = ranges;
+	    if (verbose > 1)
+		printf("and performance.\n");
+	    stats[i].secs = fsecs(eval_mm_speed, &speed_params);
+	}
+	free_trace(trace);
+    }
+    clear_ranges(&ranges);
+}
+
+/*
+ * compare_policies - Run the n traces under each placement policy in
+ *     policies[] and print their util and throughput side by side. The
+ *     allocator is left with the default policy.
+ */
+static void compare_policies(char **tracefiles, int n)
+{
+    stats_t *stats[NUM_POLICIES];
+    double util, ops, secs;
+    int i, j, p;
+
+    for (p = 0; p < NUM_POLICIES; p++) {
+	stats[p] = NULL;
+	if (mm_setopt(MM_FIT_POLICY, policies[p].fit) < 0 ||
+	    mm_setopt(MM_SPLIT_HIGH, policies[p].split) < 0)
+	    continue;
+	if ((stats[p] = (stats_t *)calloc(n, sizeof(stats_t))) == NULL)
+	    unix_error("stats calloc in compare_policies failed");
+	if (verbose > 1)
+	    printf("\nTesting mm malloc with %s fit\n", policies[p].name);
+	eval_mm(tracefiles, n, stats[p]);
+    }
+    mm_setopt(MM_FIT_POLICY, MM_FIT_BEST);
+    mm_setopt(MM_SPLIT_HIGH, 200);
+
+    /* One row per trace, a util% / Kops pair per policy */
+    printf("\nUtil%% / Kops by placement policy:\n%5s", "trace");
+    for (p = 0; p < NUM_POLICIES; p++)
+	printf("%13s", policies[p].name);
+    printf("\n");
+    for (i = 0; i <= n; i++) {
+	if (i < n)
+	    printf("%5d", i);
+	else
+	    printf("%5s", "Total");
+	for (p = 0; p < NUM_POLICIES; p++) {
+	    if (stats[p] == NULL) {
+		printf("%13s", "n/a");
+		continue;
+	    }
+	    if (i < n) {
+		if (!stats[p][i].valid) {
+		    printf("%13s", "-");
+		    continue;
+		}
+		util = stats[p][i].util;
+		ops = stats[p][i].ops;
+		secs = stats[p][i].secs;
+	    }
+	    else {
+		util = ops = secs = 0;
+		for (j = 0; j < n; j++) {
+		    util += stats[p][j].util / n;
+		    ops += stats[p][j].ops;
+		    secs += stats[p][j].secs;
+		}
+	    }
+	    printf("%6.0f%%/%6.0f", util*100.0, (ops/1e3)/secs);
+	}
+	printf("\n");
+    }
+    for (p = 0; p < NUM_POLICIES; p++)
+	free(stats[p]);
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -924,54 +1079,100 @@ static void printresults(int n, stats_t *stats)
     double secs = 0;
     double ops = 0;
     double util = 0;
+    double slack = 0;
 
     /* Print the individual results for each trace */
-    printf("%5s%7s %5s%8s%10s%6s\n", 
-	   "trace", " valid", "util", "ops", "secs", "Kops");
+    printf("%5s%7s %5s%6s%8s%10s%6s\n", 
+	   "trace", " valid", "util", "slack", "ops", "secs", "Kops");
     for (i=0; i < n; i++) {
 	if (stats[i].valid) {
-	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	    printf("%2d%10s%5.0f%%%5.0f%%%8.0f%10.6f%6.0f\n", 
 		   i,
 		   "yes",
 		   stats[i].util*100.0,
+		   stats[i].slack*100.0,
 		   stats[i].ops,
 		   stats[i].secs,
 		   (stats[i].ops/1e3)/stats[i].secs);
 	    secs += stats[i].secs;
 	    ops += stats[i].ops;
 	    util += stats[i].util;
+	    slack += stats[i].slack;
 	}
 	else {
-	    printf("%2d%10s%6s%8s%10s%6s\n", 
+	    printf("%2d%10s%6s%6s%8s%10s%6s\n", 
 		   i,
 		   "no",
 		   "-",
 		   "-",
 		   "-",
+		   "-",
 		   "-");
 	}
     }
 
     /* Print the aggregate results for the set of traces */
     if (errors == 0) {
-	printf("%12s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	printf("%12s%5.0f%%%5.0f%%%8.0f%10.6f%6.0f\n", 
 	       "Total       ",
 	       (util/n)*100.0,
+	       (slack/n)*100.0,
 	       ops, 
 	       secs,
 	       (ops/1e3)/secs);
     }
     else {
-	printf("%12s%6s%8s%10s%6s\n", 
+	printf("%12s%6s%6s%8s%10s%6s\n", 
 	       "Total       ",
 	       "-", 
 	       "-", 
 	       "-", 
+	       "-", 
 	       "-");
     }
 
 }
 
+/*
+ * printstats - prints the allocator's own counters (from mm_stats, if
+ *     it keeps them) for each trace, as they stood after its util run
+ */
+static void printstats(int n, stats_t *stats)
+{
+    mm_stats_t *c;
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+	if (!stats[i].valid || !stats[i].counted)
+	    continue;
+	c = &stats[i].counters;
+	printf("\nTrace %d counters:\n", i);
+	printf("  splits %lu, extend_heap %lu (%lu bytes), "
+	       "realloc %lu in place / %lu copied\n",
+	       (unsigned long)c->splits, (unsigned long)c->extend_calls,
+	       (unsigned long)c->extend_bytes, (unsigned long)c->realloc_inplace,
+	       (unsigned long)c->realloc_copies);
+	printf("  coalesce cases 1-4: %lu %lu %lu %lu\n",
+	       (unsigned long)c->coalesce[0], (unsigned long)c->coalesce[1],
+	       (unsigned long)c->coalesce[2], (unsigned long)c->coalesce[3]);
+	printf("  fit searches by blocks probed, %lu missed:", 
+	       (unsigned long)c->fit_misses);
+	for (j = 0; j < MM_STATS_PROBES; j++) {
+	    if (c->fit_probes[j] != 0)
+		printf(" %s%d:%lu", j == 0 ? "" : "<", j == 0 ? 0 : 1 << j,
+		       (unsigned long)c->fit_probes[j]);
+	}
+	printf("\n  free blocks/bytes by size class, %lu in fast bins:",
+	       (unsigned long)c->fast_blocks);
+	for (j = 0; j < MM_STATS_CLASSES; j++) {
+	    if (c->free_blocks[j] != 0)
+		printf(" %d:%lu/%lu", 1 << j, (unsigned long)c->free_blocks[j],
+		       (unsigned long)c->free_bytes[j]);
+	}
+	printf("\n");
+    }
+}
+
 /* 
  * app_error - Report an arbitrary application error
  */
@@ -1004,13 +1205,15 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValp] [-f <file>] [-t <dir>] [-m <size>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-m <size>  Reserve <size> bytes (K, M, G; under 4G) for the heap.\n");
+    fprintf(stderr, "\t-p         Compare the placement policies.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
@@ -3,6 +3,7 @@
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
  */
+#define _GNU_SOURCE  /* mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -14,24 +15,91 @@
 #include "memlib.h"
 #include "config.h"
 
+/*
+ * Set HUGE_PAGES to 1 (make MMFLAGS=-DHUGE_PAGES=1) to place the heap on
+ * 2MB boundaries and ask for transparent huge pages there, so that walks
+ * over a large heap take fewer TLB misses. HUGE_PAGES=2 first tries
+ * explicit hugetlb pages, falling back to the same if none are reserved.
+ */
+#ifndef HUGE_PAGES
+#define HUGE_PAGES 0
+#endif
+
+#define HUGE_PAGE_SIZE  (1UL << 21)
+
+/* The heap is reserved with no access and committed as the brk reaches
+   it, in steps of this many bytes so that most sbrks need no system call */
+#define COMMIT_SIZE  (HUGE_PAGES ? HUGE_PAGE_SIZE : 1UL << 16)
+#define COMMIT_ROUND(size)  (((size) + COMMIT_SIZE - 1) & ~(COMMIT_SIZE - 1))
+
 /* private variables */
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static char *mem_clean_brk;  /* heap bytes from here up have never been used */
+static char *mem_commit_brk; /* heap bytes from here up are reserved only */
+
+/* regions handed out by mem_map, outside the heap */
+typedef struct mem_region {
+    char *lo;                 /* first byte of the region */
+    size_t size;              /* bytes in the region */
+    struct mem_region *next;
+} mem_region_t;
+
+static mem_region_t *mem_regions; /* every live region */
+static size_t mem_mapped;    /* bytes in all regions */
+static size_t mem_peak;      /* high-water mark of heap plus region bytes */
+
+static void mem_unmap_all(void);
+static void mem_touch_peak(void);
+static char *mem_map_heap(size_t size);
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
-    /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
-	fprintf(stderr, "mem_init_vm: malloc error\n");
+    /* reserve the address space we will use to model the available VM;
+       like memory a real sbrk adds, it reads as zero until used */
+    mem_start_brk = mem_map_heap(COMMIT_ROUND(MAX_HEAP));
+    if (mem_start_brk == MAP_FAILED) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
 	exit(1);
     }
 
-    mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
+    mem_max_addr = mem_start_brk + COMMIT_ROUND(MAX_HEAP); /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_clean_brk = mem_start_brk;
+    mem_commit_brk = mem_start_brk;
+}
+
+/*
+ * mem_reserve - replace the heap's reservation with one of size bytes
+ *    (rounded up to the commit step), while the heap is empty. Returns 0,
+ *    or -1 leaving the old one in place.
+ */
+int mem_reserve(size_t size)
+{
+    char *lo;
+
+    if (size == 0) {
+	errno = EINVAL;
+	return -1;
+    }
+    size = COMMIT_ROUND(size);
+    if (size == mem_maxheapsize())
+	return 0;
+    if (mem_brk != mem_start_brk) {
+	errno = EBUSY;
+	return -1;
+    }
+    if ((lo = mem_map_heap(size)) == MAP_FAILED)
+	return -1;
+    munmap(mem_start_brk, mem_max_addr - mem_start_brk);
+
+    mem_start_brk = mem_brk = mem_clean_brk = mem_commit_brk = lo;
+    mem_max_addr = lo + size;
+    return 0;
 }
 
 /* 
@@ -39,35 +107,209 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    mem_unmap_all();
+    munmap(mem_start_brk, mem_max_addr - mem_start_brk);
+}
+
+/*
+ * mem_map_heap - reserve size bytes (a multiple of COMMIT_SIZE) of
+ *    address space for the heap, with no access and nothing committed.
+ *    With HUGE_PAGES it starts on a huge page boundary and is backed by
+ *    huge pages where the system has them.
+ */
+static char *mem_map_heap(size_t size)
+{
+#if HUGE_PAGES
+    char *p, *lo;
+
+#if HUGE_PAGES > 1
+    p = mmap(NULL, size, PROT_NONE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED)
+	return p;
+#endif
+
+    /* map a huge page more than needed and cut the aligned part out */
+    p = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_NONE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+	return p;
+    lo = (char *)(((size_t)p + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (lo > p)
+	munmap(p, lo - p);
+    munmap(lo + size, p + HUGE_PAGE_SIZE - lo);
+    madvise(lo, size, MADV_HUGEPAGE);
+    return lo;
+#else
+    return mmap(NULL, size, PROT_NONE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+#endif
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap.
+ *    The old heap's bytes are left as they were, so are no longer clean.
  */
 void mem_reset_brk()
 {
+    mem_unmap_all();
     mem_brk = mem_start_brk;
+    mem_peak = 0;
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area, or
+ *    shrinks it by -incr bytes and returns the old brk. Growth past the
+ *    high-water mark commits reserved memory. Whole pages (huge pages,
+ *    if the heap has them) given up by a shrink are handed back to the
+ *    system and the rest cleared, so the heap reads as zero when it grows
+ *    over them again; they stay committed, so regrowing is cheap.
  */
 void *mem_sbrk(int incr) 
 {
     char *old_brk = mem_brk;
+    size_t pagesize = HUGE_PAGES ? HUGE_PAGE_SIZE : mem_pagesize();
+    char *lo, *hi;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    if ((mem_brk + incr) > mem_max_addr) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
+    if ((mem_brk + incr) < mem_start_brk) {
+	errno = EINVAL;
+	fprintf(stderr, "ERROR: mem_sbrk failed. Shrunk below the heap start...\n");
+	return (void *)-1;
+    }
+    if (mem_brk + incr > mem_commit_brk) {
+	hi = mem_start_brk + COMMIT_ROUND((size_t)(mem_brk + incr - mem_start_brk));
+	if (mprotect(mem_commit_brk, hi - mem_commit_brk, PROT_READ | PROT_WRITE) != 0) {
+	    errno = ENOMEM;
+	    fprintf(stderr, "ERROR: mem_sbrk failed. Could not commit memory...\n");
+	    return (void *)-1;
+	}
+	mem_commit_brk = hi;
+    }
     mem_brk += incr;
+    mem_touch_peak();
+
+    if (incr < 0) {
+	lo = (char *)(((size_t)mem_brk + pagesize - 1) & ~(pagesize - 1));
+	hi = (char *)((size_t)old_brk & ~(pagesize - 1));
+	if (lo < hi) {
+	    memset(mem_brk, 0, lo - mem_brk);
+	    madvise(lo, hi - lo, MADV_DONTNEED);
+	    memset(hi, 0, old_brk - hi);
+	}
+	else
+	    memset(mem_brk, 0, old_brk - mem_brk);
+	if (old_brk == mem_clean_brk)
+	    mem_clean_brk = mem_brk;
+    }
+    else if (mem_brk > mem_clean_brk)
+	mem_clean_brk = mem_brk;
     return (void *)old_brk;
 }
 
+/*
+ * mem_map - model of mmap for large blocks: returns a fresh region of
+ *    size bytes outside the heap, or NULL if none is available
+ */
+void *mem_map(size_t size)
+{
+    mem_region_t *r;
+    void *lo = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (lo == MAP_FAILED)
+        return NULL;
+    if ((r = malloc(sizeof(mem_region_t))) == NULL) {
+        munmap(lo, size);
+        return NULL;
+    }
+    r->lo = lo;
+    r->size = size;
+    r->next = mem_regions;
+    mem_regions = r;
+    mem_mapped += size;
+    mem_touch_peak();
+    return lo;
+}
+
+/*
+ * mem_unmap - give the region starting at ptr back to the system
+ */
+void mem_unmap(void *ptr)
+{
+    mem_region_t **rp, *r;
+
+    for (rp = &mem_regions; (r = *rp) != NULL; rp = &r->next) {
+        if (r->lo == (char *)ptr) {
+            munmap(r->lo, r->size);
+            mem_mapped -= r->size;
+            *rp = r->next;
+            free(r);
+            return;
+        }
+    }
+}
+
+/*
+ * mem_remap - model of mremap: resizes the region starting at ptr to
+ *    size bytes, moving it if needed, and returns its new start or NULL
+ *    (leaving the region as it was)
+ */
+void *mem_remap(void *ptr, size_t size)
+{
+    mem_region_t *r;
+    void *lo;
+
+    for (r = mem_regions; r != NULL && r->lo != (char *)ptr; r = r->next)
+        ;
+    if (r == NULL)
+        return NULL;
+    if ((lo = mremap(r->lo, r->size, size, MREMAP_MAYMOVE)) == MAP_FAILED)
+        return NULL;
+    mem_mapped += size - r->size;
+    r->lo = lo;
+    r->size = size;
+    mem_touch_peak();
+    return lo;
+}
+
+/*
+ * mem_mapped_range - returns nonzero iff [lo, hi] lies in one region
+ */
+int mem_mapped_range(void *lo, void *hi)
+{
+    mem_region_t *r;
+
+    for (r = mem_regions; r != NULL; r = r->next) {
+        if ((char *)lo >= r->lo && (char *)hi < r->lo + r->size)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * mem_touch_peak - fold the current heap and region bytes into mem_peak
+ */
+static void mem_touch_peak(void)
+{
+    if (mem_heapsize() + mem_mapped > mem_peak)
+        mem_peak = mem_heapsize() + mem_mapped;
+}
+
+/*
+ * mem_unmap_all - give every region back to the system
+ */
+static void mem_unmap_all(void)
+{
+    while (mem_regions != NULL)
+        mem_unmap(mem_regions->lo);
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -84,6 +326,15 @@ void *mem_heap_hi()
     return (void *)(mem_brk - 1);
 }
 
+/*
+ * mem_heap_clean - return the address from which the heap has never been
+ *    used (or was cleared by a shrink): growth past it reads as zero
+ */
+void *mem_heap_clean()
+{
+    return (void *)mem_clean_brk;
+}
+
 /*
  * mem_heapsize() - returns the heap size in bytes
  */
@@ -92,6 +343,23 @@ size_t mem_heapsize()
     return (size_t)(mem_brk - mem_start_brk);
 }
 
+/*
+ * mem_peaksize() - returns the most bytes the heap and the mapped regions
+ *    have held together since the last mem_reset_brk
+ */
+size_t mem_peaksize()
+{
+    return mem_peak;
+}
+
+/*
+ * mem_maxheapsize() - returns the largest size the heap can grow to
+ */
+size_t mem_maxheapsize()
+{
+    return (size_t)(mem_max_addr - mem_start_brk);
+}
+
 /*
  * mem_pagesize() - returns the page size of the system
  */
@@ -99,3 +367,38 @@ size_t mem_pagesize()
 {
     return (size_t)getpagesize();
 }
+
+/*
+ * mem_hugepagesize() - returns the size of the huge pages the heap is
+ *    placed for, or 0 if HUGE_PAGES is off
+ */
+size_t mem_hugepagesize()
+{
+    return HUGE_PAGES ? HUGE_PAGE_SIZE : 0;
+}
+
+/*
+ * mem_hugepages() - returns how many huge pages back the heap now, as
+ *    the kernel reports them in /proc/self/smaps (0 if it cannot be read)
+ */
+size_t mem_hugepages()
+{
+    FILE *fp;
+    char line[256];
+    unsigned long lo, hi, kb;
+    size_t total = 0;
+    int in_heap = 0;
+
+    if ((fp = fopen("/proc/self/smaps", "r")) == NULL)
+	return 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2)
+	    in_heap = (char *)lo < mem_max_addr &&
+		(char *)hi > mem_start_brk;
+	else if (in_heap && (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1 ||
+			     sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1))
+	    total += kb;
+    }
+    fclose(fp);
+    return total * 1024 / HUGE_PAGE_SIZE;
+}
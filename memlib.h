@@ -2,10 +2,20 @@
 
 void mem_init(void);               
 void mem_deinit(void);
+int mem_reserve(size_t size);
 void *mem_sbrk(int incr);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
+void *mem_heap_clean(void);
 size_t mem_heapsize(void);
+size_t mem_peaksize(void);
+size_t mem_maxheapsize(void);
 size_t mem_pagesize(void);
+size_t mem_hugepagesize(void);
+size_t mem_hugepages(void);
+void *mem_map(size_t size);
+void mem_unmap(void *ptr);
+void *mem_remap(void *ptr, size_t size);
+int mem_mapped_range(void *lo, void *hi);
 
@@ -14,10 +14,15 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 
 #include "mm.h"
 #include "memlib.h"
 
+#if THREAD_SAFE
+#include <pthread.h>
+#endif
+
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
  * provide your team information in the following struct.
@@ -35,20 +40,94 @@ team_t team = {
     "henryraeder2020@u.northwestern.edu"
 };
 
+/*
+ * Free block index. Set USE_TLSF to 1 (e.g. make MMFLAGS=-DUSE_TLSF=1)
+ * to replace the size-ordered segregated lists with a two-level
+ * segregated fit index whose insert, remove and find are all O(1).
+ */
+#ifndef USE_TLSF
+#define USE_TLSF 0
+#endif
+
+/*
+ * Set THREAD_SAFE to 1 (make MMFLAGS="-DTHREAD_SAFE=1 -pthread") to let
+ * several threads share the allocator. Each thread then keeps a cache of
+ * freed small objects that it reaches without locking, and works in an
+ * arena of its own (see NUM_ARENAS) under that arena's lock. A separate
+ * sbrk_lock orders every arena's calls into memlib.
+ */
+#ifndef THREAD_SAFE
+#define THREAD_SAFE 0
+#endif
+
+/*
+ * Set CHECK_HEAP to 1 (make MMFLAGS=-DCHECK_HEAP=1) to check, at O(1)
+ * cost, each block an allocating call returns, free is given and coalesce
+ * produces against its neighbors and free list links, aborting on the
+ * first inconsistency. CHECK_HEAP=2 also runs mm_checkheap, a walk of the
+ * whole heap, at each of those points (single-threaded use only).
+ */
+#ifndef CHECK_HEAP
+#define CHECK_HEAP 0
+#endif
+
+/*
+ * Set COLLECT_STATS to 1 (make MMFLAGS=-DCOLLECT_STATS=1) to keep the
+ * counters mm_stats reports. Each arena counts under its own lock; other
+ * builds compile the counting out.
+ */
+#ifndef COLLECT_STATS
+#define COLLECT_STATS 0
+#endif
+
+/*
+ * Set TRACE_EVENTS to a power of two n (make MMFLAGS=-DTRACE_EVENTS=65536)
+ * to record the last n allocator calls in a ring that mm_trace_dump writes
+ * out. 0 compiles recording out.
+ */
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS 0
+#endif
+
 /* Basic constants and macros */
 #define WSIZE       4       /* Word and header/footer size (bytes) */
 #define DSIZE       8       /* Double word size (bytes) */
-#define ALIGNMENT   8       /* Double word alignment (4 for single) */
-#define CHUNKSIZE  (1<<12)  /* Extend heap by this amount (bytes) */
+#define CHUNKSIZE  (1<<12)  /* Initial heap and smallest default extension (bytes) */
+
+/* Payload alignment, 8 or 16 (e.g. make MMFLAGS=-DALIGNMENT=16) */
+#ifndef ALIGNMENT
+#define ALIGNMENT   8
+#endif
 
 /* Rounds up to nearest multiple of current alignment (in bytes) */
-#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~0x7)
+#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(ALIGNMENT-1))
+
+/* First align-byte aligned payload address in a free block at bp that
+   leaves either nothing or a minimum free block in front of it */
+#define ALIGN_PAYLOAD(bp, align) \
+    (((unsigned long)(bp) & ((align) - 1)) == 0 ? (char *)(bp) : \
+     (char *)(((unsigned long)(bp) + 2*DSIZE + (align) - 1) & ~((unsigned long)(align) - 1)))
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))
+#define MIN(x, y) ((x) < (y)? (x) : (y))
 
 /* Pack a size and allocated bit into a word */
 #define PACK(size, alloc)  ((size) | (alloc)) //line:vm:mm:pack
 
+/* Header bit set when the previous block is allocated. Only free blocks
+   carry a footer, so this is how coalesce learns about its neighbor. */
+#define PREV_ALLOC  0x2
+
+/* Header bit set on an allocated block realloc has grown. Its last word,
+   past the size last asked for, holds the slack bytes reserved there. */
+#define GROWING     0x4
+#define IS_GROWING(bp)  (GET(HDRP(bp)) & GROWING)
+
+/* The same bit on a free block: its payload has never been handed out
+   and, but for the links in its first DSIZE bytes and its footer, is zero */
+#define FRESH       0x4
+#define IS_FRESH(bp)    (GET(HDRP(bp)) & FRESH)
+
 /* Read and write a word at address p */
 #define GET(p)       (*(unsigned int *)(p))
 #define PUT(p, val)  (*(unsigned int *)(p) = (val))
@@ -56,53 +135,465 @@ team_t team = {
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p)  (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define GET_PREV_ALLOC(p) (GET(p) & PREV_ALLOC)
+
+/* Set or clear the previous-allocated bit in the header of block bp */
+#define SET_PREV_ALLOC(bp)    PUT(HDRP(bp), GET(HDRP(bp)) | PREV_ALLOC)
+#define CLEAR_PREV_ALLOC(bp)  PUT(HDRP(bp), GET(HDRP(bp)) & ~PREV_ALLOC)
 
-/* Given block ptr bp, compute address of its header and footer */
+/* Given block ptr bp, compute address of its header and footer (free
+   blocks only) */
 #define HDRP(bp)       ((char *)(bp) - WSIZE)
 #define FTRP(bp)       ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
 
 /*given a free block ptr bp, compute address of its next and previous pointer */
-#define PTRN(bp)       (*(char **)(bp))
-#define PTRP(bp)       (*(char **)(bp + WSIZE))
+#define PTRN(bp)       GET_PTR(bp)
+#define PTRP(bp)       GET_PTR((char *)(bp) + WSIZE)
 
 /* Given block ptr bp, compute address of next and previous blocks */
 #define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
+/* Block size for a size-byte payload: header, alignment and the minimum
+   block a free block's header, links and footer need */
+#define ADJUST_SIZE(size)  MAX(2*DSIZE, ALIGN((size) + WSIZE))
+
 /* Size of a size_t accounting for alignment */
 #define SIZE_T_SIZE (ALIGN(sizeof(size_t)))
 
-/* Number of segregated lists */
-#define NUM_SEG_LISTS  20
+/*
+ * Number of segregated lists. List i holds blocks of 2^i to 2^(i+1)-1
+ * bytes, except the last (TREE_BIN), which holds every block of at
+ * least 2^TREE_BIN bytes in a splay tree ordered by size then address.
+ */
+#define NUM_SEG_LISTS  15
+#define TREE_BIN       (NUM_SEG_LISTS - 1)
+
+/*
+ * TLSF index: the first level splits sizes by power of two, the second
+ * level splits each power-of-two range into TLSF_SL_COUNT equal lists.
+ * Sizes below TLSF_SMALL go to first level 0, whose lists are DSIZE apart.
+ */
+#define TLSF_SL_LOG2   4
+#define TLSF_SL_COUNT  (1 << TLSF_SL_LOG2)
+#define TLSF_FL_SHIFT  (TLSF_SL_LOG2 + 3)
+#define TLSF_SMALL     (1 << TLSF_FL_SHIFT)
+#define TLSF_FL_COUNT  (32 - TLSF_FL_SHIFT + 1)
+
+/* Number of free list heads, and bytes of heap taken by the free index */
+#if USE_TLSF
+#define NUM_FREE_LISTS   (TLSF_FL_COUNT * TLSF_SL_COUNT)
+#define FREE_INDEX_SIZE  (NUM_FREE_LISTS * sizeof(char *) + TLSF_FL_COUNT * WSIZE)
+#else
+#define NUM_FREE_LISTS   NUM_SEG_LISTS
+#define FREE_INDEX_SIZE  (NUM_FREE_LISTS * sizeof(char *))
+#endif
+
+/*
+ * Arenas: independent heaps, each with its own free index, slab lists and
+ * lock, grown from their own segments of the memlib heap. THREAD_SAFE
+ * builds have NUM_ARENAS of them (make MMFLAGS="... -DNUM_ARENAS=8") and
+ * hand them to threads round robin; other builds have exactly one.
+ */
+#if !THREAD_SAFE
+#undef NUM_ARENAS
+#define NUM_ARENAS  1
+#elif !defined(NUM_ARENAS)
+#define NUM_ARENAS  4
+#endif
+#if NUM_ARENAS > 255
+#error "NUM_ARENAS must fit the byte arena_mapp keeps per page"
+#endif
+
+typedef struct arena {
+    char *seg_listp;          /* Explicit List Root */
+    char *slab_listp;         /* Partial run list of each slab class */
+    char *fast_listp;         /* Fast bin of each small block size */
+    unsigned int fast_count;  /* Blocks waiting in the fast bins */
+    size_t grow_size;         /* Bytes the last heap extension asked for */
+    unsigned int alloc_clock; /* Heap allocations made so far */
+    unsigned int grow_clock;  /* alloc_clock at the last heap extension */
+    char *heap_endp;          /* End of the arena's newest segment */
+    unsigned int seg_bitmap;  /* Bit i set iff seg_list (TLSF: first level) i is non-empty */
+    size_t grow_slack;        /* Bytes reserved past the sizes growing blocks asked for */
+    char *roverp;             /* Where the next MM_FIT_NEXT search starts */
+#if THREAD_SAFE
+    pthread_mutex_t lock;
+    char *remote_freep;       /* Blocks freed by other arenas' threads */
+#endif
+} arena_t;
 
 /* Global variables */
+static char *heap_basep;      /* Start of the heap, origin of every link */
+static char *heap_maxp;       /* End of the largest heap memlib allows */
+static size_t map_threshold;  /* Smallest request given its own region */
 static char *heap_listp = 0;  /* Pointer to first block */
-static char *seg_listp;        /* Explicit List Root*/
+static arena_t *arena_tablep;  /* The NUM_ARENAS arena records */
+static char *slab_mapp;        /* Bit per heap page, set iff the page is a run */
+#if NUM_ARENAS > 1
+static unsigned char *arena_mapp; /* Byte per heap page: index of its arena */
+#endif
+#if THREAD_SAFE
+static __thread arena_t *arenap;  /* Arena the running operation works on */
+#else
+static arena_t *arenap;
+#endif
 
 /* Segregated list helpers */
 
-#define PUT_PTR(p, ptr)  (*(unsigned int *)(p) = (unsigned int)(ptr))
+/*
+ * Links between free blocks (and slab runs) are single words holding the
+ * target's offset from heap_basep in DSIZE units, 0 standing for NULL.
+ * They stay 4 bytes on 64-bit hosts and reach 32GB of heap.
+ */
+#define LINK_SHIFT  3  /* log2(DSIZE) */
+#define PUT_PTR(p, ptr)  PUT(p, (ptr) == NULL ? 0 : \
+    (unsigned int)(((char *)(ptr) - heap_basep) >> LINK_SHIFT))
+#define GET_PTR(p)  (GET(p) == 0 ? NULL : \
+    heap_basep + ((size_t)GET(p) << LINK_SHIFT))
 
 /* Get address of the previous or next field of a free seg_list block */
 #define GET_PREV(bp)    ((char *)bp)
 #define GET_NEXT(bp)    ((char *)(bp) + WSIZE)
 
 /* Get address of previous or next block in list */
-#define GET_PREV_BLK(bp)    (*(char **)(bp))
-#define GET_NEXT_BLK(bp)    (*(char **)(GET_NEXT(bp)))
+#define GET_PREV_BLK(bp)    GET_PTR(GET_PREV(bp))
+#define GET_NEXT_BLK(bp)    GET_PTR(GET_NEXT(bp))
 
 /* Gets particular list from set of all seg_lists */
 #define SEG_LIST(ptr, index) (*((char **)ptr+index))
 
+/* Index of the seg_list holding blocks of size bytes: floor(log2(size)),
+   with everything past the last list lumped into it */
+#define SEG_INDEX(size)  (MIN(31 - __builtin_clz((unsigned int)(size)), \
+                              NUM_SEG_LISTS - 1))
+
+/* Children of a free block in the TREE_BIN splay tree */
+#define TREE_LEFT(bp)         GET_PREV_BLK(bp)
+#define TREE_RIGHT(bp)        GET_NEXT_BLK(bp)
+#define SET_LEFT(bp, child)   PUT_PTR(GET_PREV(bp), child)
+#define SET_RIGHT(bp, child)  PUT_PTR(GET_NEXT(bp), child)
+
+/*
+ * Slab tier: requests of at most SLAB_MAX bytes are carved from runs of
+ * equal-sized objects with no per-object boundary tags. A run is an
+ * ordinary allocated block of exactly RUN_SIZE bytes whose payload starts
+ * on a RUN_SIZE boundary; it begins with a run header and ends where the
+ * next block's header sits. Runs are told apart from ordinary blocks by a
+ * bitmap with one bit per RUN_SIZE page of the heap.
+ */
+#define SLAB_MAX          128
+#define SLAB_QUANTUM      16  /* object sizes are multiples of this */
+#define NUM_SLAB_CLASSES  (SLAB_MAX / SLAB_QUANTUM)
+#define RUN_SHIFT         12
+#define RUN_SIZE          (1 << RUN_SHIFT)
+#define RUN_MAP_WORDS     8   /* free bitmap covers 256 objects */
+#define RUN_HDR_SIZE      ALIGN((4 + RUN_MAP_WORDS) * WSIZE)
+
+/* Slab class serving a request of size bytes, and its object size */
+#define SLAB_CLASS(size)     (((size) - 1) / SLAB_QUANTUM)
+#define SLAB_OBJSIZE(class)  (((class) + 1) * SLAB_QUANTUM)
+
+/* Run header: object size, free object count, partial list links and a
+   free bitmap (bit set = object free) */
+#define RUN_OBJSIZE(run)  GET(run)
+#define RUN_NFREE(run)    GET((char *)(run) + WSIZE)
+#define RUN_NEXTP(run)    ((char *)(run) + 2*WSIZE)
+#define RUN_PREVP(run)    ((char *)(run) + 3*WSIZE)
+#define RUN_NEXT(run)     GET_PTR(RUN_NEXTP(run))
+#define RUN_PREV(run)     GET_PTR(RUN_PREVP(run))
+#define RUN_MAP(run)      ((unsigned int *)((char *)(run) + 4*WSIZE))
+#define RUN_CAPACITY(run) ((RUN_SIZE - WSIZE - RUN_HDR_SIZE) / RUN_OBJSIZE(run))
+
+/* Run containing slab object bp */
+#define RUN_OF(bp)  ((char *)((unsigned long)(bp) & ~(unsigned long)(RUN_SIZE - 1)))
+
+/* Partial run list of a slab class, and the page bit covering address p.
+   Pages are counted on RUN_SIZE boundaries, as runs are, not from the
+   heap start, which need not lie on one. */
+#define SLAB_LIST(class)  SEG_LIST(arenap->slab_listp, class)
+#define PAGE_INDEX(p)     (((unsigned long)(p) >> RUN_SHIFT) - \
+                           ((unsigned long)heap_basep >> RUN_SHIFT))
+#define PAGE_WORD(p)      (((unsigned int *)slab_mapp)[PAGE_INDEX(p) / 32])
+#define PAGE_BIT(p)       (1u << (PAGE_INDEX(p) % 32))
+#define IS_SLAB(p)        (PAGE_WORD(p) & PAGE_BIT(p))
+
+/* Mark or unmark the page at p as a run. Map words span pages of
+   different arenas, so threads update them atomically. */
+#if THREAD_SAFE
+#define SET_SLAB(p)    __sync_fetch_and_or(&PAGE_WORD(p), PAGE_BIT(p))
+#define CLEAR_SLAB(p)  __sync_fetch_and_and(&PAGE_WORD(p), ~PAGE_BIT(p))
+#else
+#define SET_SLAB(p)    (PAGE_WORD(p) |= PAGE_BIT(p))
+#define CLEAR_SLAB(p)  (PAGE_WORD(p) &= ~PAGE_BIT(p))
+#endif
+
+/* Arena owning the block or object at p */
+#if NUM_ARENAS > 1
+#define ARENA_OF(p)  (arena_tablep + arena_mapp[PAGE_INDEX(p)])
+#else
+#define ARENA_OF(p)  arena_tablep
+#endif
+
+/* TLSF list (fl, sl) and the second-level bitmap of first level fl */
+#define TLSF_LIST(fl, sl)  SEG_LIST(arenap->seg_listp, (fl) * TLSF_SL_COUNT + (sl))
+#define TLSF_SL_MAP(fl) \
+    (((unsigned int *)(arenap->seg_listp + NUM_FREE_LISTS * sizeof(char *)))[fl])
+
+/*
+ * Requests of at least map_threshold bytes get a region of their own from
+ * mem_map, which mm_free unmaps and mm_realloc resizes with mem_remap. The
+ * region size, a multiple of RUN_SIZE, is kept in a size_t in front of the
+ * payload. map_threshold starts at MAP_THRESHOLD (e.g. make
+ * MMFLAGS=-DMAP_THRESHOLD=131072) and, as in glibc, rises to the size of
+ * any region freed, up to MAP_THRESHOLD_MAX, so that short-lived buffers
+ * of a recurring size stop costing a map and unmap each.
+ */
+#ifndef MAP_THRESHOLD
+#define MAP_THRESHOLD      (64*1024)
+#endif
+#define MAP_THRESHOLD_MAX  (1024*1024)
+
+/* Threads read map_threshold without a lock, so every access is atomic */
+#define GET_MAP_THRESHOLD()   __atomic_load_n(&map_threshold, __ATOMIC_RELAXED)
+#define SET_MAP_THRESHOLD(n)  __atomic_store_n(&map_threshold, (n), __ATOMIC_RELAXED)
+#define MAP_ROUND(size)  (((size) + RUN_SIZE - 1) & ~(size_t)(RUN_SIZE - 1))
+#define MAP_REGION(bp)   ((char *)(bp) - SIZE_T_SIZE)
+#define MAP_SIZE(bp)     (*(size_t *)MAP_REGION(bp))
+#define IS_MAPPED(bp)    ((char *)(bp) < heap_basep || (char *)(bp) >= heap_maxp)
+
+/*
+ * Heap trimming: when a free brings the free block at the top of the heap
+ * to TRIM_THRESHOLD bytes, the heap is shrunk to leave TRIM_PAD of it.
+ */
+#ifndef TRIM_THRESHOLD
+#define TRIM_THRESHOLD  (128*1024)
+#endif
+#define TRIM_PAD        (TRIM_THRESHOLD/2)
+
+/*
+ * Realloc growth prediction: a block's first growth reserves as much
+ * slack again as it grew by, and a block that grows past its slack gets
+ * a quarter of its new size, up to GROW_SLACK_MAX bytes. A block grown a
+ * little at a time is then copied a logarithmic number of times rather
+ * than on every call. mm_grow_slack reports the slack not yet used.
+ */
+#define GROW_SLACK_MAX  (32*1024)
+
+/*
+ * Fast bins: a freed block of at most FAST_MAX bytes is pushed, still
+ * marked allocated, onto a LIFO list of blocks of its exact size, where
+ * the next request of that size pops it. Fast blocks are freed for real
+ * and coalesced only when a fit search misses. A TLSF build keeps none,
+ * as that consolidation takes time linear in the bins and TLSF bounds
+ * every call by a constant.
+ */
+#if USE_TLSF
+#define FAST_MAX        0
+#else
+#define FAST_MAX        256
+#endif
+#define NUM_FAST_BINS   (FAST_MAX / ALIGNMENT + 1)
+#define FAST_BIN(size)  SEG_LIST(arenap->fast_listp, (size) / ALIGNMENT)
+
+/*
+ * Heap growth: an arena's extensions start at grow_min bytes and double,
+ * up to grow_max, while each comes within grow_burst allocations of the
+ * last; then they halve back. mm_setopt changes all three at run time.
+ */
+#define GROW_MIN    CHUNKSIZE
+#define GROW_MAX    (64*1024)
+#define GROW_BURST  64
+
+static size_t grow_min = GROW_MIN;
+static size_t grow_max = GROW_MAX;
+static unsigned int grow_burst = GROW_BURST;
+
+/*
+ * Heap size: with heap_max_opt set, mm_init has memlib reserve that much
+ * address space for the heap, committed only as the heap grows into it.
+ * The allocator uses up to HEAP_LIMIT of it, since block sizes are 32-bit
+ * header fields, and asks mem_sbrk for at most SBRK_MAX bytes at a time.
+ */
+#define HEAP_LIMIT  ((size_t)0xffffffffu & ~(size_t)(RUN_SIZE - 1))
+#define SBRK_MAX    (1 << 30)
+
+static size_t heap_max_opt;   /* Reservation the next mm_init asks for; 0: keep memlib's */
+
+/*
+ * Placement policy: fit_policy, an MM_FIT_ value that mm_init latches
+ * from the last mm_setopt, sets how each segregated list is ordered and
+ * searched:
+ *   MM_FIT_BEST     sorted by size, so the first fit is the best fit
+ *   MM_FIT_FIRST    LIFO; take the first block that fits
+ *   MM_FIT_NEXT     LIFO; resume each search where the last one ended
+ *   MM_FIT_ADDRESS  sorted by address; take the lowest block that fits
+ * The TREE_BIN tree is searched best fit under every policy, and TLSF
+ * builds support MM_FIT_BEST only. place puts an allocation at the high
+ * end of its free block when the remainder is at least split_high bytes,
+ * so small and large blocks collect at opposite ends of free space.
+ */
+#define SPLIT_HIGH  200
+
+static int fit_opt = MM_FIT_BEST;     /* Policy the next mm_init adopts */
+static int fit_policy = MM_FIT_BEST;
+static size_t split_high = SPLIT_HIGH;
+
+/*
+ * Thread caches: per thread, a list of freed objects for each class of
+ * TCACHE_QUANTUM-byte request sizes up to TCACHE_MAX. A class holds at
+ * most TCACHE_FULL objects and is refilled from, or flushed to, the
+ * shared heap TCACHE_BATCH objects at a time. The cache itself is a
+ * table of (list head, count) word pairs carved from the heap.
+ */
+#define TCACHE_MAX          512
+#define TCACHE_QUANTUM      16
+#define NUM_TCACHE_CLASSES  (TCACHE_MAX / TCACHE_QUANTUM)
+#define TCACHE_FULL         32
+#define TCACHE_BATCH        16
+#define TCACHE_SIZE         (2 * NUM_TCACHE_CLASSES * WSIZE)
+
+/* Cache class serving a request of size bytes, and the size it asks for */
+#define TCACHE_CLASS(size)    (((size) - 1) / TCACHE_QUANTUM)
+#define TCACHE_OBJSIZE(cls)   (((cls) + 1) * TCACHE_QUANTUM)
+
+/* Address of the list head, and the object count, of class cls in tc */
+#define TCACHE_HEAD(tc, cls)   ((char *)(tc) + 2*(cls)*WSIZE)
+#define TCACHE_COUNT(tc, cls)  GET((char *)(tc) + (2*(cls) + 1)*WSIZE)
+
+#if THREAD_SAFE
+static pthread_mutex_t sbrk_lock = PTHREAD_MUTEX_INITIALIZER; /* Guards all memlib calls */
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tcache_key;     /* Flushes a thread's cache at exit */
+static unsigned int heap_epoch;      /* Bumped by mm_init to drop old thread state */
+static unsigned int next_arena;      /* Round robin arena assignment */
+static __thread arena_t *home_arenap; /* This thread's arena */
+static __thread char *tcachep;       /* This thread's cache */
+static __thread unsigned int thread_epoch; /* heap_epoch the two above belong to */
+
+#define UNLOCK_ARENA(a)  pthread_mutex_unlock(&(a)->lock)
+#define LOCK_SBRK()      pthread_mutex_lock(&sbrk_lock)
+#define UNLOCK_SBRK()    pthread_mutex_unlock(&sbrk_lock)
+#else
+#define LOCK_SBRK()
+#define UNLOCK_SBRK()
+#endif
+
+#if CHECK_HEAP
+#define CHECK_BLOCK(bp)  checkblock(bp)
+#define CHECK_FREE(bp)   checkfree(bp)
+#else
+#define CHECK_BLOCK(bp)  (bp)
+#define CHECK_FREE(bp)
+#endif
+
+#if COLLECT_STATS
+/* Counters for mm_stats, a set per arena, kept outside the heap so that
+   counting leaves the heap layout as it was */
+static struct {
+    mm_stats_t counts;
+    size_t probes;            /* Blocks the running fit search has probed */
+} arena_stats[NUM_ARENAS];
+
+#define STATS       (arena_stats[arenap - arena_tablep].counts)
+#define STAT_PROBES (arena_stats[arenap - arena_tablep].probes)
+#define STAT(stmt)  (stmt)
+#else
+#define STAT(stmt)
+#endif
+
+#if TRACE_EVENTS
+#if TRACE_EVENTS & (TRACE_EVENTS - 1)
+#error "TRACE_EVENTS must be a power of two"
+#endif
+/* The event ring, outside the heap like the stats. trace_count events have
+   been recorded since mm_init; the last TRACE_EVENTS of them are kept. */
+static mm_event_t trace_ring[TRACE_EVENTS];
+static unsigned long trace_count;
+#if THREAD_SAFE
+static __thread int trace_bin;  /* Free list this call's fit came from, or -1 */
+#else
+static int trace_bin;
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+#define TRACE_CYCLES()  __builtin_ia32_rdtsc()
+#else
+#define TRACE_CYCLES()  clock()
+#endif
+
+/* The public names are defined at the end of the file, where they record
+   each call and pass it on. Calls from inside the allocator, such as
+   mm_realloc's to mm_malloc, go straight to the untraced versions. */
+#define mm_malloc   untraced_malloc
+#define mm_calloc   untraced_calloc
+#define mm_free     untraced_free
+#define mm_realloc  untraced_realloc
+#define mm_malloc_batch    untraced_malloc_batch
+#define mm_memalign        untraced_memalign
+#define mm_posix_memalign  untraced_posix_memalign
+#endif
+
+/* Size class mm_stats counts a free block of size bytes in */
+#define STAT_CLASS(size)  MIN(31 - __builtin_clz((unsigned int)(size)), MM_STATS_CLASSES - 1)
+
+/* Errors found by the running mm_checkheap */
+static int check_errors;
+
 /* Function prototypes for internal helper routines */
 static void *extend_heap(size_t words);
 static void *place(void *bp, size_t asize);
 static void *find_fit(size_t asize);
+static void *fit_block(size_t asize);
+static void *fast_pop(size_t asize);
+static void *free_block(void *bp);
+static void fast_consolidate(void);
+static size_t grow_chunk(void);
+static void *grow_heap(size_t asize);
 static void *coalesce(void *bp);
-static void m_check(int verbose);
-static void checkblock(void *bp);
+#if USE_TLSF
+static void tlsf_mapping(size_t size, int *fl, int *sl);
+#endif
+#if CHECK_HEAP
+static void *checkblock(void *bp);
+static void checkfree(void *bp);
+#endif
+static char *blockerr(void *bp);
+static char *linkerr(void *bp);
+static char *runerr(char *run);
+static void check_fail(void *bp, char *msg);
+static void check_index(arena_t *a, size_t nfree);
+static void check_bins(arena_t *a);
 static void insert_free_block(void *bp, size_t b_size);
 static void remove_free_block(void *bp);
+static void *alloc_aligned(size_t align, size_t asize);
+static void *slab_malloc(size_t size);
+static void slab_free(void *bp);
+static void *heap_malloc(size_t size);
+static void *heap_calloc(size_t size);
+static int heap_malloc_batch(size_t n, size_t sizes[], void *out[]);
+static void heap_free(void *bp);
+static void *heap_realloc(void *ptr, size_t size);
+static size_t usable_size(void *bp);
+static void *map_malloc(size_t size);
+static void map_free(void *bp);
+static void *map_realloc(void *ptr, size_t size);
+static int heap_trim(size_t pad);
+static int heap_expand(void *ptr, size_t need, size_t want);
+static size_t heap_try_expand(void *ptr, size_t min, size_t max);
+static void *mark_growing(void *bp, size_t asize);
+#if THREAD_SAFE
+static arena_t *thread_arena(void);
+static arena_t *arena_fallback(arena_t *a);
+static void arena_lock(arena_t *a);
+static void remote_free(arena_t *a, char *bp);
+static void tcache_make_key(void);
+static void tcache_release(void *tc);
+static char *tcache_get(void);
+static int tcache_class(void *bp);
+static void tcache_fill(char *tc, int cls);
+static void tcache_flush(char *tc, int cls, int n);
+#endif
 
 /*
  * mm_init - Initialize the memory manager
@@ -110,22 +601,91 @@ static void remove_free_block(void *bp);
 /* $begin mminit */
 int mm_init(void)
 {
-    int list_index;
-    seg_listp = mem_sbrk(NUM_SEG_LISTS*WSIZE);
+    int list_index, i;
+    size_t npages, map_size;
+
+#if THREAD_SAFE
+    pthread_once(&tcache_once, tcache_make_key);
+    heap_epoch++;
+#endif
+    if (heap_max_opt != 0 && mem_reserve(heap_max_opt) < 0)
+        return -1;
+    heap_basep = mem_heap_lo();
+    heap_maxp = heap_basep + MIN(mem_maxheapsize(), HEAP_LIMIT);
+    npages = ((heap_maxp - heap_basep) >> RUN_SHIFT) + 2;
+    map_size = ALIGN(npages / 8 + 1);
+    SET_MAP_THRESHOLD(MAP_THRESHOLD);
+    fit_policy = fit_opt;
+#if COLLECT_STATS
+    memset(arena_stats, 0, sizeof(arena_stats));
+#endif
+#if TRACE_EVENTS
+    trace_count = 0;
+#endif
+    if ((arena_tablep = mem_sbrk(ALIGN(NUM_ARENAS * sizeof(arena_t)))) == (void *)-1)
+        return -1;
+
+    /* Each arena gets its own free index and slab class lists */
+    for (i = 0; i < NUM_ARENAS; i++) {
+        arenap = arena_tablep + i;
+        if ((arenap->seg_listp = mem_sbrk(ALIGN(FREE_INDEX_SIZE))) == (void *)-1)
+            return -1;
 
-    /* Initialize all lists */
-    for (list_index = 0; list_index < NUM_SEG_LISTS; list_index++) {
-        SEG_LIST(seg_listp, list_index) = NULL;
+        /* Initialize all lists */
+        for (list_index = 0; list_index < NUM_FREE_LISTS; list_index++) {
+            SEG_LIST(arenap->seg_listp, list_index) = NULL;
+        }
+#if USE_TLSF
+        for (list_index = 0; list_index < TLSF_FL_COUNT; list_index++) {
+            TLSF_SL_MAP(list_index) = 0;
+        }
+#endif
+        arenap->seg_bitmap = 0;
+
+        if ((arenap->slab_listp = mem_sbrk(ALIGN(NUM_SLAB_CLASSES*sizeof(char *)))) == (void *)-1)
+            return -1;
+        for (list_index = 0; list_index < NUM_SLAB_CLASSES; list_index++) {
+            SLAB_LIST(list_index) = NULL;
+        }
+        if ((arenap->fast_listp = mem_sbrk(ALIGN(NUM_FAST_BINS*sizeof(char *)))) == (void *)-1)
+            return -1;
+        for (list_index = 0; list_index < NUM_FAST_BINS; list_index++) {
+            SEG_LIST(arenap->fast_listp, list_index) = NULL;
+        }
+        arenap->fast_count = 0;
+        arenap->grow_size = grow_min;
+        arenap->alloc_clock = arenap->grow_clock = 0;
+        arenap->heap_endp = NULL;
+        arenap->grow_slack = 0;
+        arenap->roverp = NULL;
+#if THREAD_SAFE
+        pthread_mutex_init(&arenap->lock, NULL);
+        arenap->remote_freep = NULL;
+#endif
     }
 
+    /* The run page map, and the page owner map if there are arenas to tell apart */
+    if ((slab_mapp = mem_sbrk(map_size)) == (void *)-1)
+        return -1;
+    memset(slab_mapp, 0, map_size);
+#if NUM_ARENAS > 1
+    if ((arena_mapp = mem_sbrk(ALIGN(npages))) == (void *)-1)
+        return -1;
+    memset(arena_mapp, 0, ALIGN(npages));
+#endif
+
+    /* The first arena's heap follows the prefix */
+    arenap = arena_tablep;
+
     /* Create empty heap */
     if ((heap_listp = mem_sbrk(4*WSIZE)) == (void *)-1)
         return -1;
     PUT(heap_listp, 0);
     PUT(heap_listp + (1*WSIZE), PACK(DSIZE, 1));
     PUT(heap_listp + (2*WSIZE), PACK(DSIZE, 1));
-    PUT(heap_listp + (3*WSIZE), PACK(0,1));
+    PUT(heap_listp + (3*WSIZE), PACK(0, 1 | PREV_ALLOC));
     heap_listp += (2*WSIZE);
+    arenap->heap_endp = heap_listp + (2*WSIZE);
 
     /* Extend the empty heap with a free block of CHUNKSIZE bytes */
     if (extend_heap(CHUNKSIZE/WSIZE) == NULL)
@@ -134,323 +694,1940 @@ int mm_init(void)
 }
 
 /*
- * mm_malloc - Allocate a block with at least size bytes of payload
+ * mm_malloc - Allocate a block with at least size bytes of payload. In
+ *             THREAD_SAFE builds small requests come from the thread cache
+ *             and the rest from the thread's arena.
  */
-/* $begin mmmalloc */
 void *mm_malloc(size_t size)
 {
-    size_t asize;      /* Adjusted block size */
-    size_t extendsize; /* Amount to extend heap if no fit */
-    char *bp;
+#if THREAD_SAFE
+    arena_t *a;
+    char *tc, *bp;
+    int cls;
+#endif
+
+    if (size >= GET_MAP_THRESHOLD())
+        return map_malloc(size);
+
+#if THREAD_SAFE
+
+    if (size != 0 && size <= TCACHE_MAX && (tc = tcache_get()) != NULL) {
+        cls = TCACHE_CLASS(size);
+        if (TCACHE_COUNT(tc, cls) == 0)
+            tcache_fill(tc, cls);
+        if ((bp = GET_PTR(TCACHE_HEAD(tc, cls))) != NULL) {
+            PUT_PTR(TCACHE_HEAD(tc, cls), GET_PTR(bp));
+            TCACHE_COUNT(tc, cls)--;
+            return bp;
+        }
+        /* The thread's arena is full; try the others below */
+    }
 
-    /* Nothing to allocate */
-    if (size == 0)
+    a = thread_arena();
+    do {
+        arena_lock(a);
+        bp = heap_malloc(size);
+        UNLOCK_ARENA(a);
+    } while (bp == NULL && size != 0 && (a = arena_fallback(a)) != NULL);
+    return bp;
+#else
+    return heap_malloc(size);
+#endif
+}
+
+/*
+ * mm_calloc - Allocate zeroed space for nmemb objects of size bytes each,
+ *             clearing only the bytes that may have been used before
+ */
+void *mm_calloc(size_t nmemb, size_t size)
+{
+    size_t bytes;
+#if THREAD_SAFE
+    arena_t *a;
+    void *bp;
+#endif
+
+    if (nmemb != 0 && size > (size_t)-1 / nmemb)
         return NULL;
+    bytes = nmemb * size;
 
-    /* Adjust block size to include overhead and alignment reqs. */
-    if (size <= DSIZE)
-        asize = 2*DSIZE;
-    else
-        asize = DSIZE * ((size + (DSIZE) + (DSIZE-1)) / DSIZE);
+    /* A new region is zero already */
+    if (bytes >= GET_MAP_THRESHOLD())
+        return map_malloc(bytes);
 
-    /* Search the free list for a fit */
-    if ((bp = find_fit(asize)) != NULL) {
-        bp = place(bp, asize);
+#if THREAD_SAFE
+    /* Cached objects have all been used */
+    if (bytes != 0 && bytes <= TCACHE_MAX) {
+        if ((bp = mm_malloc(bytes)) != NULL)
+            memset(bp, 0, bytes);
         return bp;
     }
 
-    /* No fit found. Get more memory and place the block */
-    extendsize = MAX(asize,CHUNKSIZE);
-    if ((bp = extend_heap(extendsize/WSIZE)) == NULL)
-        return NULL;
-    bp = place(bp, asize);
+    a = thread_arena();
+    do {
+        arena_lock(a);
+        bp = heap_calloc(bytes);
+        UNLOCK_ARENA(a);
+    } while (bp == NULL && bytes != 0 && (a = arena_fallback(a)) != NULL);
     return bp;
+#else
+    return heap_calloc(bytes);
+#endif
 }
-/* $end mmmalloc */
 
 /*
- * mm_free - Free a block
+ * mm_malloc_batch - Allocate n blocks of sizes[i] bytes, storing them in
+ *                   out[i] (NULL for size 0). The blocks are cut side by
+ *                   side from one free block and each may be passed to
+ *                   mm_free alone, so even blocks of map_threshold bytes or
+ *                   more come from the heap. Returns 0, or -1 with nothing
+ *                   allocated (and out untouched) if the heap cannot hold
+ *                   them all.
  */
-void mm_free(void *bp)
+int mm_malloc_batch(size_t n, size_t sizes[], void *out[])
 {
-    size_t size = GET_SIZE(HDRP(bp));
+#if THREAD_SAFE
+    arena_t *a = thread_arena();
+    int ret;
+
+    do {
+        arena_lock(a);
+        ret = heap_malloc_batch(n, sizes, out);
+        UNLOCK_ARENA(a);
+    } while (ret != 0 && (a = arena_fallback(a)) != NULL);
+    return ret;
+#else
+    return heap_malloc_batch(n, sizes, out);
+#endif
+}
 
-    /* Updates headers to show as unallocated */
-    PUT(HDRP(bp), PACK(size, 0));
-    PUT(FTRP(bp), PACK(size, 0));
+/*
+ * mm_memalign - Allocate a block of at least size bytes whose payload is
+ *               aligned to alignment, a power of two. The free space in
+ *               front of it is split off as a free block, not wasted.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+#if THREAD_SAFE
+    arena_t *a;
+    void *bp;
+#endif
 
-    /* Inserts newly-freed block into proper list */
-    insert_free_block(bp, size);
-    coalesce(bp);
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (alignment <= ALIGNMENT)
+        return mm_malloc(size);
+    if (size == 0)
+        return NULL;
+    if (alignment > HEAP_LIMIT || size > HEAP_LIMIT - alignment) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+#if THREAD_SAFE
+    a = thread_arena();
+    do {
+        arena_lock(a);
+        bp = alloc_aligned(alignment, ADJUST_SIZE(size));
+        UNLOCK_ARENA(a);
+    } while (bp == NULL && (a = arena_fallback(a)) != NULL);
+    return bp;
+#else
+    return alloc_aligned(alignment, ADJUST_SIZE(size));
+#endif
 }
 
-/* $end mmfree */
 /*
- * coalesce - Boundary tag coalescing. Return ptr to coalesced block
+ * mm_posix_memalign - posix_memalign on top of mm_memalign: alignment must
+ *                     also be a multiple of sizeof(void *). Returns 0, or
+ *                     EINVAL or ENOMEM leaving *memptr alone.
  */
-/* $begin mmfree */
-static void *coalesce(void *bp)
+int mm_posix_memalign(void **memptr, size_t alignment, size_t size)
 {
-    char *prv = PREV_BLKP(bp);
-    char *nxt = NEXT_BLKP(bp);
-    size_t prev_alloc = GET_ALLOC(FTRP(prv));
-    size_t next_alloc = GET_ALLOC(HDRP(nxt));
-    size_t size = GET_SIZE(HDRP(bp));
+    void *bp;
+
+    if (alignment == 0 || alignment % sizeof(void *) != 0 ||
+        (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    if ((bp = mm_memalign(alignment, size)) == NULL && size != 0)
+        return ENOMEM;
+    *memptr = bp;
+    return 0;
+}
 
-    if (prev_alloc && next_alloc) {            /* Case 1 */
-        return bp;                 /* Nothing to coalesce */
-    }
+/*
+ * mm_free - Free a block. In THREAD_SAFE builds small objects go to the
+ *           thread cache, a full cache class is flushed by half, and other
+ *           blocks go back to the arena that owns them, through its remote
+ *           free queue if that is not the thread's own arena.
+ */
+void mm_free(void *bp)
+{
+#if THREAD_SAFE
+    arena_t *a;
+    char *tc;
+    int cls;
+#endif
 
-    else if (prev_alloc && !next_alloc) {      /* Case 2 */
-                                    /* Coalesce forwards */
-        remove_free_block(bp);
-        remove_free_block(NEXT_BLKP(bp));
-        size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-        PUT(HDRP(bp), PACK(size, 0));
-        PUT(FTRP(bp), PACK(size,0));
+    if (bp == NULL)
+        return;
+    if (IS_MAPPED(bp)) {
+        map_free(bp);
+        return;
     }
 
-    else if (!prev_alloc && next_alloc) {      /* Case 3 */
-                                 /* Coalesce backwards */
-        remove_free_block(bp);
-        remove_free_block(PREV_BLKP(bp));
-        size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-        PUT(FTRP(bp), PACK(size, 0));
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-        bp = PREV_BLKP(bp);
-    }
+#if THREAD_SAFE
+    /* Grown blocks skip the cache, where their slack would go unaccounted */
+    cls = !IS_SLAB(bp) && IS_GROWING(bp) ? -1 : tcache_class(bp);
 
-    else {                                     /* Case 4 */
-                                /* Bidirectional coalesce */
-        remove_free_block(PREV_BLKP(bp));
-        remove_free_block(bp);
-        remove_free_block(NEXT_BLKP(bp));
-        size += GET_SIZE(HDRP(PREV_BLKP(bp))) + GET_SIZE(FTRP(NEXT_BLKP(bp)));
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-        bp = PREV_BLKP(bp);
+    if (cls >= 0 && cls < NUM_TCACHE_CLASSES && (tc = tcache_get()) != NULL) {
+        if (TCACHE_COUNT(tc, cls) == TCACHE_FULL)
+            tcache_flush(tc, cls, TCACHE_BATCH);
+        PUT_PTR(bp, GET_PTR(TCACHE_HEAD(tc, cls)));
+        PUT_PTR(TCACHE_HEAD(tc, cls), bp);
+        TCACHE_COUNT(tc, cls)++;
+        return;
     }
 
-    insert_free_block(bp, size);
-    return bp;
+    /* Another arena's block waits in its queue instead of taking its lock */
+    if ((a = ARENA_OF(bp)) != thread_arena()) {
+        remote_free(a, bp);
+        return;
+    }
+    arena_lock(a);
+    heap_free(bp);
+    UNLOCK_ARENA(a);
+#else
+    heap_free(bp);
+#endif
 }
 
-
 /*
- * mm_realloc - Naive implementation of realloc
+ * mm_realloc - Resize a block, in place when the heap allows it. Blocks
+ *              that reach map_threshold move to a mapped region. In
+ *              THREAD_SAFE builds the block stays in the arena owning it.
  */
 void *mm_realloc(void *ptr, size_t size)
 {
-    size_t oldsize, asize, next_size;
+#if THREAD_SAFE
+    arena_t *a;
     void *newptr;
-    void *nextblk;
+#endif
 
-    /* Just free */
+    if (ptr == NULL)
+        return mm_malloc(size);
     if (size == 0) {
         mm_free(ptr);
         return NULL;
     }
-
-    /* Just malloc */
-    if (ptr == NULL) {
-        return mm_malloc(size);
-    }
-
-    asize = ALIGN(size);
-
-    oldsize = GET_SIZE(HDRP(ptr)) - DSIZE; //Subtracts header and footer size
-
-    if (asize == oldsize) {
-        return ptr;
+    if (IS_MAPPED(ptr) || size >= GET_MAP_THRESHOLD())
+        return map_realloc(ptr, size);
+
+#if THREAD_SAFE
+    a = ARENA_OF(ptr);
+    arena_lock(a);
+    newptr = heap_realloc(ptr, size);
+    UNLOCK_ARENA(a);
+
+    /* If the owner is full, the block moves to whichever arena has room */
+    if (newptr == NULL && (newptr = mm_malloc(size)) != NULL) {
+        memcpy(newptr, ptr, MIN(size, usable_size(ptr)));
+        mm_free(ptr);
     }
+    return newptr;
+#else
+    return heap_realloc(ptr, size);
+#endif
+}
 
-    /* Previously-allocated block can fit new block */
-    if (asize < oldsize){
-        if (oldsize - asize - DSIZE <= DSIZE)
-            return ptr;
-        
-        PUT(HDRP(ptr), PACK(asize + DSIZE, 1));
-        PUT(FTRP(ptr), PACK(asize + DSIZE, 1));
-
-        newptr = ptr;
+/*
+ * mm_usable_size - Bytes of payload block ptr really has, all of which the
+ *                  caller may use
+ */
+size_t mm_usable_size(void *ptr)
+{
+    return ptr == NULL ? 0 : usable_size(ptr);
+}
 
-        ptr = NEXT_BLKP(newptr);
+/*
+ * mm_try_expand - Grow block ptr in place, never moving it, to at least min
+ *                 and at most max bytes of payload, using the free block
+ *                 after it or the end of the heap. Returns the new usable
+ *                 size, or 0 (with ptr unchanged) if min cannot be reached.
+ */
+size_t mm_try_expand(void *ptr, size_t min, size_t max)
+{
+#if THREAD_SAFE
+    arena_t *a;
+    size_t usable;
+#endif
 
-        PUT(HDRP(ptr), PACK(oldsize - asize, 0));
-        PUT(FTRP(ptr), PACK(oldsize - asize, 0));
+    if (ptr == NULL || min > max)
+        return 0;
+    max = MIN(max, (size_t)(heap_maxp - heap_basep));
+    if (IS_MAPPED(ptr))
+        return usable_size(ptr) >= min ? usable_size(ptr) : 0;
+
+#if THREAD_SAFE
+    a = ARENA_OF(ptr);
+    arena_lock(a);
+    usable = heap_try_expand(ptr, min, max);
+    UNLOCK_ARENA(a);
+    return usable;
+#else
+    return heap_try_expand(ptr, min, max);
+#endif
+}
 
-        insert_free_block(ptr, GET_SIZE(HDRP(ptr)));
-        coalesce(ptr);
-        return newptr;
+/*
+ * mm_grow_slack - Bytes realloc has reserved after growing blocks that
+ *                 they have not grown into yet
+ */
+size_t mm_grow_slack(void)
+{
+    size_t slack = 0;
+    arena_t *a;
+
+    for (a = arena_tablep; a < arena_tablep + NUM_ARENAS; a++) {
+#if THREAD_SAFE
+        arena_lock(a);
+        slack += a->grow_slack;
+        UNLOCK_ARENA(a);
+#else
+        slack += a->grow_slack;
+#endif
     }
-    
-    nextblk = NEXT_BLKP(ptr);
-    /* Next block in memory is free and may be of use */
-    if (!GET_ALLOC(HDRP(nextblk)) && nextblk != NULL){
-        next_size = GET_SIZE(HDRP(nextblk));
-
-        if (next_size + oldsize >= asize){
-            remove_free_block(nextblk);
-
-            if (next_size + oldsize - asize <= DSIZE){
-                // Extra space cannot be used due to alignment--allocate it all
-                PUT(HDRP(ptr), PACK(oldsize + DSIZE + next_size, 1));
-                return ptr;
-            }
+    return slack;
+}
 
-            else {
-                // Extra space can be used--coalesce the extra
-                PUT(HDRP(ptr), PACK(asize + DSIZE, 1));
-                PUT(FTRP(ptr), PACK(asize + DSIZE, 1));
-                newptr = ptr;
-                ptr = NEXT_BLKP(newptr);
-                PUT(HDRP(ptr), PACK(oldsize + next_size - asize, 0));
-                PUT(FTRP(ptr), PACK(oldsize + next_size - asize, 0));
-                insert_free_block(ptr, GET_SIZE(HDRP(ptr)));
-                return newptr;
-            }
-        }
+/*
+ * mm_trim - Shrink the heap so that at most pad bytes of free space stay
+ *           at its top. Returns 1 if any memory was released, else 0.
+ */
+int mm_trim(size_t pad)
+{
+#if THREAD_SAFE
+    arena_t *a;
+    int released = 0;
+
+    /* Only the arena whose segment ends at the brk can give any back */
+    for (a = arena_tablep; a < arena_tablep + NUM_ARENAS; a++) {
+        arena_lock(a);
+        fast_consolidate();
+        released |= heap_trim(pad);
+        UNLOCK_ARENA(a);
     }
-
-    /* We must allocate a new block */
-    newptr = mm_malloc(size);
-    if (newptr == NULL)
-        return NULL;
-
-    memcpy(newptr, ptr, oldsize);
-    mm_free(ptr);
-    return newptr;
-
-
+    return released;
+#else
+    fast_consolidate();
+    return heap_trim(pad);
+#endif
 }
 
 /*
- * mm_checkheap - Check the heap for correctness
- *//*
-void mm_checkheap()
+ * mm_setopt - Set allocator parameter param (an MM_ constant from mm.h)
+ *             to value. Returns 0, or -1 if either is invalid. Set before
+ *             other threads use the allocator; MM_FIT_POLICY and
+ *             MM_HEAP_MAX take effect at the next mm_init.
+ */
+int mm_setopt(int param, size_t value)
 {
-    return checkheap();
-}*/
+    switch (param) {
+    case MM_GROW_MIN:
+        if (value < 2*DSIZE || value > grow_max)
+            return -1;
+        grow_min = ALIGN(value);
+        return 0;
+    case MM_GROW_MAX:
+        if (value < grow_min)
+            return -1;
+        grow_max = ALIGN(value);
+        return 0;
+    case MM_GROW_BURST:
+        grow_burst = value;
+        return 0;
+    case MM_FIT_POLICY:
+#if USE_TLSF
+        if (value != MM_FIT_BEST)
+            return -1;
+#endif
+        if (value > MM_FIT_ADDRESS)
+            return -1;
+        fit_opt = value;
+        return 0;
+    case MM_SPLIT_HIGH:
+        split_high = value;
+        return 0;
+    case MM_HEAP_MAX:
+        if (value > HEAP_LIMIT)
+            return -1;
+        heap_max_opt = value;
+        return 0;
+    default:
+        return -1;
+    }
+}
 
 /*
- * The remaining routines are internal helper routines
+ * mm_stats - Fill in stats with the counters of every arena since mm_init.
+ *            Returns 0, or -1 (stats untouched) if they are compiled out.
  */
+int mm_stats(mm_stats_t *stats)
+{
+#if COLLECT_STATS
+    size_t *sum = (size_t *)stats, *count;
+    arena_t *a;
+    int i, j;
+
+    memset(stats, 0, sizeof(mm_stats_t));
+    for (i = 0; i < NUM_ARENAS; i++) {
+        a = arena_tablep + i;
+#if THREAD_SAFE
+        arena_lock(a);
+#endif
+        arena_stats[i].counts.fast_blocks = a->fast_count;
+
+        /* Every field is a size_t count, so arenas add up word by word */
+        count = (size_t *)&arena_stats[i].counts;
+        for (j = 0; j < sizeof(mm_stats_t) / sizeof(size_t); j++)
+            sum[j] += count[j];
+#if THREAD_SAFE
+        UNLOCK_ARENA(a);
+#endif
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
 
 /*
- * extend_heap - Extend heap with free block and return its block pointer
+ * mm_trace_dump - Write an mm_trace_hdr_t and then the recorded events,
+ *                 oldest first, to fp. Returns the number of events, or -1
+ *                 on a write error or if recording is compiled out. No
+ *                 other thread may be in the allocator meanwhile.
  */
-static void *extend_heap(size_t words)
+int mm_trace_dump(FILE *fp)
 {
-  char *bp;
-  size_t size;
-
-  /* Allocate an even number of words to maintain alignment */
-  size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
-  if ((long)(bp = mem_sbrk(size)) == -1)
-      return NULL;
+#if TRACE_EVENTS
+    mm_trace_hdr_t hdr = {MM_TRACE_MAGIC, 0};
+    size_t start, n;
+
+    hdr.count = MIN(trace_count, TRACE_EVENTS);
+    start = (trace_count - hdr.count) & (TRACE_EVENTS - 1);
+    n = MIN(hdr.count, TRACE_EVENTS - start);
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        fwrite(trace_ring + start, sizeof(mm_event_t), n, fp) != n ||
+        fwrite(trace_ring, sizeof(mm_event_t), hdr.count - n, fp) != hdr.count - n ||
+        fflush(fp) != 0)
+        return -1;
+    return hdr.count;
+#else
+    return -1;
+#endif
+}
 
-  /* Initialize free block header/footer and the epilogue header */
-  PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
-  PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
-  PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
-  insert_free_block(bp, size);
+/*
+ * mm_checkheap - Walk every heap segment checking each block, then check
+ *                each arena's free index, fast bins and slab lists against
+ *                what the walk found. Prints every problem (and, if verbose,
+ *                every block) and returns 1 if the heap is consistent, else
+ *                0. No other thread may be in the allocator meanwhile.
+ */
+int mm_checkheap(int verbose)
+{
+    size_t nfree[NUM_ARENAS] = {0}, slack[NUM_ARENAS] = {0};
+    arena_t *saved = arenap;
+    char *bp = heap_listp, *brk = (char *)mem_heap_hi() + 1;
+    char *msg, *p;
+    int i;
+
+    check_errors = 0;
+    if (GET_SIZE(HDRP(bp)) != DSIZE || !GET_ALLOC(HDRP(bp)))
+        check_fail(bp, "is a bad prologue");
+
+    /* A segment ends at an epilogue; the next starts ALIGNMENT bytes into
+       the page after it, as extend_heap lays it out */
+    for (bp = NEXT_BLKP(bp); ; bp = (char *)MAP_ROUND((size_t)bp) + ALIGNMENT) {
+        for (; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+            arenap = ARENA_OF(bp);
+            i = arenap - arena_tablep;
+            if (verbose)
+                printf("%p: %s block of %u bytes, arena %d\n", bp,
+                       !GET_ALLOC(HDRP(bp)) ? "free" : IS_SLAB(bp) ? "run" : "allocated",
+                       GET_SIZE(HDRP(bp)), i);
+            if ((msg = blockerr(bp)) != NULL) {
+                check_fail(bp, msg);
+                if (GET_SIZE(HDRP(bp)) % ALIGNMENT != 0 || NEXT_BLKP(bp) > brk)
+                    goto done;  /* the next header cannot be found */
+            }
+            if (GET_ALLOC(HDRP(bp))) {
+                if (!IS_SLAB(bp) && IS_GROWING(bp))
+                    slack[i] += GET(FTRP(bp));
+                continue;
+            }
+            nfree[i]++;
+            for (p = bp + DSIZE; IS_FRESH(bp) && p < FTRP(bp); p += WSIZE) {
+                if (GET(p) != 0) {
+                    check_fail(bp, "is marked fresh but holds data");
+                    break;
+                }
+            }
+        }
+        if (!GET_ALLOC(HDRP(bp)))
+            check_fail(bp, "is a bad epilogue");
+        if (bp >= brk)
+            break;
+    }
 
-  /* Coalesce if the previous block was free */
-  return coalesce(bp);
+    for (i = 0; i < NUM_ARENAS; i++) {
+        arenap = arena_tablep + i;
+        check_index(arenap, nfree[i]);
+        check_bins(arenap);
+        if (slack[i] != arenap->grow_slack)
+            check_fail(NULL, "grow slack count disagrees with the growing blocks");
+    }
+done:
+    arenap = saved;
+    return check_errors == 0;
 }
 
 /*
- * place - Place block of asize bytes at start of free block bp
- *         and split if remainder would be at least minimum block size
+ * heap_malloc - Allocate a block with at least size bytes of payload
  */
-static void *place(void *bp, size_t asize)
+/* $begin mmmalloc */
+static void *heap_malloc(size_t size)
 {
-    size_t csize = GET_SIZE(HDRP(bp));
+    size_t asize;      /* Adjusted block size */
+    char *bp;
+
+    /* Nothing to allocate */
+    if (size == 0)
+        return NULL;
+    arenap->alloc_clock++;
+
+    /* Small objects come from the slab tier */
+    if (size <= SLAB_MAX)
+        return CHECK_BLOCK(slab_malloc(size));
+
+    /* Adjust block size to include overhead and alignment reqs. */
+    asize = ADJUST_SIZE(size);
+
+    /* A block of this size freed lately is the quickest fit */
+    if (asize <= FAST_MAX && (bp = fast_pop(asize)) != NULL)
+        return CHECK_BLOCK(bp);
+
+    /* Search the free list for a fit */
+    if ((bp = fit_block(asize)) != NULL) {
+        bp = place(bp, asize);
+        return CHECK_BLOCK(bp);
+    }
+
+    /* No fit found. Get more memory and place the block */
+    if ((bp = grow_heap(asize)) == NULL)
+        return NULL;
+    bp = place(bp, asize);
+    return CHECK_BLOCK(bp);
+}
+/* $end mmmalloc */
+
+/*
+ * heap_malloc_batch - Place one block covering all n requests with a single
+ *                     fit, then split it into a block per request. The
+ *                     last block takes whatever place() left over.
+ */
+static int heap_malloc_batch(size_t n, size_t sizes[], void *out[])
+{
+    size_t i, total = 0, csize, asize, prev_alloc;
+    char *bp;
+
+    /* Check the sizes before ADJUST_SIZE or the sum can wrap */
+    for (i = 0; i < n; i++) {
+        if (sizes[i] == 0)
+            continue;
+        if (sizes[i] > HEAP_LIMIT || ADJUST_SIZE(sizes[i]) > HEAP_LIMIT - total)
+            return -1;
+        total += ADJUST_SIZE(sizes[i]);
+    }
+    if (total == 0) {
+        for (i = 0; i < n; i++)
+            out[i] = NULL;
+        return 0;
+    }
+
+    arenap->alloc_clock++;
+    if ((bp = fit_block(total)) == NULL && (bp = grow_heap(total)) == NULL)
+        return -1;
+    bp = place(bp, total);
+    csize = GET_SIZE(HDRP(bp));
+    prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+
+    for (i = 0; i < n; i++) {
+        if (sizes[i] == 0) {
+            out[i] = NULL;
+            continue;
+        }
+        asize = ADJUST_SIZE(sizes[i]);
+        total -= asize;
+        if (total == 0)
+            asize = csize;
+        PUT(HDRP(bp), PACK(asize, 1 | prev_alloc));
+        out[i] = bp;
+        bp += asize;
+        csize -= asize;
+        prev_alloc = PREV_ALLOC;
+    }
+#if CHECK_HEAP
+    for (i = 0; i < n; i++)
+        checkblock(out[i]);
+#endif
+    return 0;
+}
+
+/*
+ * heap_calloc - Allocate a block with at least size bytes of zeroed
+ *               payload. A block placed in a fresh free block only has
+ *               that block's links and footer to clear.
+ */
+static void *heap_calloc(size_t size)
+{
+    size_t asize;
+    char *bp;
+    int fresh;
+
+    if (size == 0)
+        return NULL;
+    arenap->alloc_clock++;
+
+    if (size <= SLAB_MAX) {
+        if ((bp = slab_malloc(size)) != NULL)
+            memset(bp, 0, size);
+        return CHECK_BLOCK(bp);
+    }
+
+    asize = ADJUST_SIZE(size);
+    fresh = 0;
+    if (asize > FAST_MAX || (bp = fast_pop(asize)) == NULL) {
+        if ((bp = fit_block(asize)) == NULL && (bp = grow_heap(asize)) == NULL)
+            return NULL;
+        fresh = IS_FRESH(bp);
+        bp = place(bp, asize);
+    }
+
+    if (!fresh)
+        memset(bp, 0, size);
+    else {
+        memset(bp, 0, DSIZE);
+        PUT(FTRP(bp), 0);
+    }
+    return CHECK_BLOCK(bp);
+}
+
+/*
+ * heap_free - Free a block
+ */
+static void heap_free(void *bp)
+{
+    size_t size;
+
+    CHECK_FREE(bp);
+    if (IS_SLAB(bp)) {
+        slab_free(bp);
+        return;
+    }
+
+    size = GET_SIZE(HDRP(bp));
+    if (IS_GROWING(bp))
+        arenap->grow_slack -= GET(FTRP(bp));
+
+    /* Small blocks wait in a fast bin, still looking allocated */
+    if (size <= FAST_MAX) {
+        PUT(HDRP(bp), PACK(size, 1 | GET_PREV_ALLOC(HDRP(bp))));
+        PUT_PTR(bp, FAST_BIN(size));
+        FAST_BIN(size) = bp;
+        arenap->fast_count++;
+        return;
+    }
+
+    bp = free_block(bp);
+
+    /* Give back most of a large free block at the top of the heap */
+    if (GET_SIZE(HDRP(bp)) >= TRIM_THRESHOLD && GET_SIZE(HDRP(NEXT_BLKP(bp))) == 0)
+        heap_trim(TRIM_PAD);
+}
+
+/* $end mmfree */
+
+/*
+ * free_block - Mark allocated block bp free, index it and coalesce it with
+ *              its free neighbors. Returns the coalesced block.
+ */
+static void *free_block(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+
+    /* Updates headers to show as unallocated */
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp))));
+    PUT(FTRP(bp), PACK(size, 0));
+    CLEAR_PREV_ALLOC(NEXT_BLKP(bp));
+
+    /* Inserts newly-freed block into proper list */
+    insert_free_block(bp, size);
+    return coalesce(bp);
+}
+
+/*
+ * fast_pop - Take a block of exactly asize bytes from its fast bin, or
+ *            return NULL if the bin is empty
+ */
+static void *fast_pop(size_t asize)
+{
+    char *bp = FAST_BIN(asize);
+
+    if (bp != NULL) {
+        FAST_BIN(asize) = GET_PTR(bp);
+        arenap->fast_count--;
+    }
+    return bp;
+}
+
+/*
+ * fast_consolidate - Free every block in the fast bins for real, letting
+ *                    each coalesce with its neighbors
+ */
+static void fast_consolidate(void)
+{
+    size_t size;
+    char *bp;
+
+    for (size = 0; arenap->fast_count > 0 && size <= FAST_MAX; size += ALIGNMENT) {
+        while ((bp = fast_pop(size)) != NULL)
+            free_block(bp);
+    }
+}
+
+/*
+ * fit_block - find_fit, but on a miss consolidate the fast bins and search
+ *             once more before the caller grows the heap
+ */
+static void *fit_block(size_t asize)
+{
+    char *bp;
+#if TRACE_EVENTS && USE_TLSF
+    int fl, sl;
+#endif
+
+    STAT(STAT_PROBES = 0);
+    if ((bp = find_fit(asize)) == NULL && arenap->fast_count > 0) {
+        fast_consolidate();
+        bp = find_fit(asize);
+    }
+#if COLLECT_STATS
+    if (bp == NULL)
+        STATS.fit_misses++;
+    STATS.fit_probes[STAT_PROBES == 0 ? 0 :
+        MIN(32 - __builtin_clz((unsigned int)STAT_PROBES), MM_STATS_PROBES - 1)]++;
+#endif
+#if TRACE_EVENTS
+    /* Number the TLSF lists row by row */
+    if (bp != NULL) {
+#if USE_TLSF
+        tlsf_mapping(GET_SIZE(HDRP(bp)), &fl, &sl);
+        trace_bin = fl * TLSF_SL_COUNT + sl;
+#else
+        trace_bin = SEG_INDEX(GET_SIZE(HDRP(bp)));
+#endif
+    }
+#endif
+    return bp;
+}
+
+/*
+ * coalesce - Boundary tag coalescing. Return ptr to coalesced block
+ */
+/* $begin mmfree */
+static void *coalesce(void *bp)
+{
+    char *nxt = NEXT_BLKP(bp);
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    size_t next_alloc = GET_ALLOC(HDRP(nxt));
+    size_t size = GET_SIZE(HDRP(bp));
+
+    if (prev_alloc && next_alloc) {            /* Case 1 */
+        STAT(STATS.coalesce[0]++);
+        return bp;                 /* Nothing to coalesce */
+    }
+
+    else if (prev_alloc && !next_alloc) {      /* Case 2 */
+        STAT(STATS.coalesce[1]++);
+                                    /* Coalesce forwards */
+        remove_free_block(bp);
+        remove_free_block(NEXT_BLKP(bp));
+        size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
+        PUT(HDRP(bp), PACK(size, prev_alloc));
+        PUT(FTRP(bp), PACK(size,0));
+    }
+
+    else if (!prev_alloc && next_alloc) {      /* Case 3 */
+        STAT(STATS.coalesce[2]++);
+                                 /* Coalesce backwards */
+        remove_free_block(bp);
+        remove_free_block(PREV_BLKP(bp));
+        size += GET_SIZE(HDRP(PREV_BLKP(bp)));
+        PUT(FTRP(bp), PACK(size, 0));
+        PUT(HDRP(PREV_BLKP(bp)), PACK(size, GET_PREV_ALLOC(HDRP(PREV_BLKP(bp)))));
+        bp = PREV_BLKP(bp);
+    }
+
+    else {                                     /* Case 4 */
+        STAT(STATS.coalesce[3]++);
+                                /* Bidirectional coalesce */
+        remove_free_block(PREV_BLKP(bp));
+        remove_free_block(bp);
+        remove_free_block(NEXT_BLKP(bp));
+        size += GET_SIZE(HDRP(PREV_BLKP(bp))) + GET_SIZE(FTRP(NEXT_BLKP(bp)));
+        PUT(HDRP(PREV_BLKP(bp)), PACK(size, GET_PREV_ALLOC(HDRP(PREV_BLKP(bp)))));
+        PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
+        bp = PREV_BLKP(bp);
+    }
+
+    insert_free_block(bp, size);
+    return CHECK_BLOCK(bp);
+}
+
+
+/*
+ * heap_realloc - Resize a block: shrink in place, grow into a free next
+ *                block, or else move the data to a new block
+ */
+static void *heap_realloc(void *ptr, size_t size)
+{
+    size_t oldsize, asize, need, prev_alloc, slack = 0;
+    int grown, growth;
+    void *newptr;
+
+    /* Just free */
+    if (size == 0) {
+        heap_free(ptr);
+        return NULL;
+    }
+
+    /* Just malloc */
+    if (ptr == NULL) {
+        return heap_malloc(size);
+    }
+
+    /* Slab objects stay put while they fit, else move to a new block */
+    if (IS_SLAB(ptr)) {
+        oldsize = RUN_OBJSIZE(RUN_OF(ptr));
+        if (size <= oldsize) {
+            STAT(STATS.realloc_inplace++);
+            return CHECK_BLOCK(ptr);
+        }
+        if ((newptr = heap_malloc(size)) == NULL)
+            return NULL;
+        STAT(STATS.realloc_copies++);
+        memcpy(newptr, ptr, oldsize);
+        slab_free(ptr);
+        return newptr;
+    }
+
+    need = asize = ADJUST_SIZE(size);
+    oldsize = GET_SIZE(HDRP(ptr));
+    prev_alloc = GET_PREV_ALLOC(HDRP(ptr));
+
+    /* A grown block grows again when it outgrows the size last asked for */
+    if ((grown = IS_GROWING(ptr))) {
+        slack = GET(FTRP(ptr));
+        arenap->grow_slack -= slack;
+        PUT(HDRP(ptr), PACK(oldsize, 1 | prev_alloc));
+    }
+    growth = need > oldsize - slack;
+
+    /* Growth into the slack, while a word of it is left to record it in */
+    if (growth && need < oldsize) {
+        STAT(STATS.realloc_inplace++);
+        return CHECK_BLOCK(mark_growing(ptr, need));
+    }
+
+    /* Previously-allocated block can fit new block */
+    if (!growth){
+        STAT(STATS.realloc_inplace++);
+        if (oldsize - asize < 2*DSIZE)
+            return CHECK_BLOCK(ptr);
+
+        PUT(HDRP(ptr), PACK(asize, 1 | prev_alloc));
+
+        newptr = ptr;
+
+        ptr = NEXT_BLKP(newptr);
+
+        PUT(HDRP(ptr), PACK(oldsize - asize, PREV_ALLOC));
+        PUT(FTRP(ptr), PACK(oldsize - asize, 0));
+        CLEAR_PREV_ALLOC(NEXT_BLKP(ptr));
+
+        insert_free_block(ptr, GET_SIZE(HDRP(ptr)));
+        coalesce(ptr);
+        return CHECK_BLOCK(newptr);
+    }
+
+    /* Aim for the new size plus predicted slack, settling for less */
+    asize = need + MIN(ALIGN(grown ? need / 4 : need - oldsize), GROW_SLACK_MAX);
+
+    if (heap_expand(ptr, need, asize)) {
+        STAT(STATS.realloc_inplace++);
+        return CHECK_BLOCK(mark_growing(ptr, need));
+    }
+
+    /* We must allocate a new block */
+    if ((newptr = heap_malloc(asize - WSIZE)) == NULL &&
+        (newptr = heap_malloc(size)) == NULL)
+        return NULL;
+
+    STAT(STATS.realloc_copies++);
+    memcpy(newptr, ptr, oldsize - WSIZE);
+    heap_free(ptr);
+    return CHECK_BLOCK(IS_SLAB(newptr) ? newptr : mark_growing(newptr, need));
+
+
+}
+
+/*
+ * The remaining routines are internal helper routines
+ */
+
+/*
+ * extend_heap - Extend heap with free block and return its block pointer
+ */
+static void *extend_heap(size_t words)
+{
+  char *bp, *prev;
+  size_t size, lead = 0, huge;
+  int fresh;
+
+  /* Round up to a whole number of alignment units */
+  size = ALIGN(words * WSIZE);
+
+  /*
+   * Grow the arena's newest segment if it still ends at the brk, so the
+   * old epilogue becomes the new block's header. Otherwise start a new
+   * segment on a fresh page, its first payload ALIGNMENT bytes in.
+   */
+  LOCK_SBRK();
+  bp = (char *)mem_heap_hi() + 1;
+  if (arenap->heap_endp != bp)
+      lead = ((RUN_SIZE - ((unsigned long)bp & (RUN_SIZE - 1))) & (RUN_SIZE - 1)) + ALIGNMENT;
+
+  /* On a huge page heap, run the block on to a huge page boundary: the
+     system backs the whole page once any of it is touched */
+  if ((huge = mem_hugepagesize()) != 0)
+      size += (huge - ((unsigned long)(bp + lead + size) & (huge - 1))) & (huge - 1);
+  fresh = (char *)mem_heap_clean() <= bp;
+  if (lead + size > SBRK_MAX || bp + lead + size > heap_maxp ||
+      (long)(bp = mem_sbrk(lead + size)) == -1) {
+      UNLOCK_SBRK();
+      return NULL;
+  }
+  bp += lead;
+  arenap->heap_endp = bp + size;
+  UNLOCK_SBRK();
+  STAT(STATS.extend_calls++);
+  STAT(STATS.extend_bytes += lead + size);
+
+  /* Nothing before a segment's first block to coalesce with */
+  if (lead)
+      PUT(HDRP(bp), PACK(0, PREV_ALLOC));
+#if NUM_ARENAS > 1
+  memset(arena_mapp + PAGE_INDEX(bp), arenap - arena_tablep,
+         PAGE_INDEX(bp + size - 1) - PAGE_INDEX(bp) + 1);
+#endif
+
+  /* Initialize free block header/footer and the epilogue header */
+  PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)) | (fresh ? FRESH : 0))); /* Free block header */
+  PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
+  PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
+  insert_free_block(bp, size);
+
+  /* Coalesce if the previous block was free */
+  if (!fresh || GET_PREV_ALLOC(HDRP(bp)) || !IS_FRESH(PREV_BLKP(bp)))
+      return coalesce(bp);
+
+  /* Two fresh blocks merge into one once the tags and links between them
+     are cleared */
+  prev = coalesce(bp);
+  memset(bp - DSIZE, 0, 2*DSIZE);
+  PUT(HDRP(prev), GET(HDRP(prev)) | FRESH);
+  return prev;
+}
+
+/*
+ * heap_expand - Grow allocated block ptr in place to want bytes, or to as
+ *               much short of that as the free block after it holds, but
+ *               at least need bytes. Returns 1 if the block grew, else 0.
+ */
+static int heap_expand(void *ptr, size_t need, size_t want)
+{
+    size_t oldsize = GET_SIZE(HDRP(ptr));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(ptr));
+    size_t next_size;
+    char *nextblk = NEXT_BLKP(ptr);
+
+    next_size = GET_ALLOC(HDRP(nextblk)) ? 0 : GET_SIZE(HDRP(nextblk));
+
+    /*
+     * Block (with any free block after it) is the last one at the brk:
+     * extend the heap by just the shortfall, which lands in the next block.
+     * The brk is read unlocked; if another arena moves it first, the
+     * extension is a new segment and the block is copied as before.
+     */
+    if (oldsize + next_size < want && nextblk + next_size == arenap->heap_endp
+        && arenap->heap_endp == (char *)mem_heap_hi() + 1)
+        extend_heap(MAX(want - oldsize - next_size, 2*DSIZE) / WSIZE);
+
+    /* Next block in memory is free and may be of use */
+    if (GET_ALLOC(HDRP(nextblk)))
+        return 0;
+    next_size = GET_SIZE(HDRP(nextblk));
+    if (next_size + oldsize < need)
+        return 0;
+    if (next_size + oldsize < want)
+        want = next_size + oldsize;
+    remove_free_block(nextblk);
+
+    if (next_size + oldsize - want < 2*DSIZE){
+        // Extra space is below a minimum block--allocate it all
+        PUT(HDRP(ptr), PACK(oldsize + next_size, 1 | prev_alloc));
+        SET_PREV_ALLOC(NEXT_BLKP(ptr));
+    }
+    else {
+        // Extra space can be used--split it off as a free block
+        PUT(HDRP(ptr), PACK(want, 1 | prev_alloc));
+        nextblk = NEXT_BLKP(ptr);
+        PUT(HDRP(nextblk), PACK(oldsize + next_size - want, PREV_ALLOC));
+        PUT(FTRP(nextblk), PACK(oldsize + next_size - want, 0));
+        insert_free_block(nextblk, GET_SIZE(HDRP(nextblk)));
+    }
+    return 1;
+}
+
+/*
+ * heap_try_expand - Grow heap block or slab object ptr in place towards max
+ *                   bytes of payload. Returns its usable size if at least
+ *                   min, else 0.
+ */
+static size_t heap_try_expand(void *ptr, size_t min, size_t max)
+{
+    size_t usable;
+
+    if (IS_SLAB(ptr)) {
+        usable = RUN_OBJSIZE(RUN_OF(ptr));
+        return usable >= min ? usable : 0;
+    }
+
+    if (usable_size(ptr) < max) {
+        /* The caller takes over a growing block's slack */
+        if (IS_GROWING(ptr)) {
+            arenap->grow_slack -= GET(FTRP(ptr));
+            PUT(HDRP(ptr), GET(HDRP(ptr)) & ~GROWING);
+        }
+        heap_expand(ptr, ADJUST_SIZE(min), ADJUST_SIZE(max));
+    }
+    usable = usable_size(CHECK_BLOCK(ptr));
+    return usable >= min ? usable : 0;
+}
+
+/*
+ * mark_growing - Flag block bp as grown by realloc and record the slack it
+ *                holds past the asize bytes asked for. A block with no
+ *                slack has no free word to record it in and is not flagged.
+ */
+static void *mark_growing(void *bp, size_t asize)
+{
+    size_t slack = GET_SIZE(HDRP(bp)) - asize;
+
+    if (slack == 0)
+        return bp;
+    PUT(HDRP(bp), GET(HDRP(bp)) | GROWING);
+    PUT(FTRP(bp), slack);
+    arenap->grow_slack += slack;
+    return bp;
+}
+
+/*
+ * grow_chunk - Bytes the arena's next heap extension should at least add:
+ *              twice the last while misses come in a burst, else half
+ */
+static size_t grow_chunk(void)
+{
+    if (arenap->alloc_clock - arenap->grow_clock < grow_burst)
+        arenap->grow_size = MIN(arenap->grow_size * 2, grow_max);
+    else
+        arenap->grow_size = MAX(arenap->grow_size / 2, grow_min);
+    arenap->grow_clock = arenap->alloc_clock;
+    return arenap->grow_size;
+}
+
+/*
+ * grow_heap - Extend the heap after a miss for asize bytes and return a free
+ *             block that fits them. A free block already ending the arena
+ *             at the brk holds part of asize, so only the rest is asked for
+ *             (or grow_chunk(), if more).
+ */
+static void *grow_heap(size_t asize)
+{
+    size_t chunk = grow_chunk(), top = 0;
+    char *bp, *endp = arenap->heap_endp;
+
+    if (endp == (char *)mem_heap_hi() + 1 && !GET_PREV_ALLOC(endp - WSIZE))
+        top = MIN(GET_SIZE(endp - DSIZE), asize);
+    if ((bp = extend_heap(MAX(asize - top, chunk)/WSIZE)) == NULL)
+        return NULL;
+
+    /* Another arena moved the brk first, so the extension is a new segment */
+    if (GET_SIZE(HDRP(bp)) < asize && (bp = extend_heap(MAX(asize, chunk)/WSIZE)) == NULL)
+        return NULL;
+    return bp;
+}
+
+/*
+ * heap_trim - If the arena's newest segment ends at the brk with a free
+ *             block, shrink the heap to leave pad bytes (at least a minimum
+ *             block) of it. Returns 1 if the heap shrank.
+ */
+static int heap_trim(size_t pad)
+{
+    char *bp, *endp = arenap->heap_endp;
+    size_t size, release, huge, keep;
+
+    LOCK_SBRK();
+    if (endp != (char *)mem_heap_hi() + 1 || GET_PREV_ALLOC(endp - WSIZE)) {
+        UNLOCK_SBRK();
+        return 0;
+    }
+
+    /* The epilogue says the block before it is free; its footer says how big */
+    size = GET_SIZE(endp - DSIZE);
+    bp = endp - size;
+    release = (size - MIN(size, MAX(pad, 2*DSIZE))) & ~(size_t)(ALIGNMENT - 1);
+
+    /* Keep the brk on a huge page boundary, giving back whole pages only */
+    if ((huge = mem_hugepagesize()) != 0) {
+        keep = (huge - ((unsigned long)(endp - release) & (huge - 1))) & (huge - 1);
+        release = release > keep ? release - keep : 0;
+    }
+    release = MIN(release, SBRK_MAX);
+    if (release == 0) {
+        UNLOCK_SBRK();
+        return 0;
+    }
+
+    remove_free_block(bp);
+    mem_sbrk(-(int)release);
+    arenap->heap_endp = endp - release;
+    UNLOCK_SBRK();
+
+    size -= release;
+    PUT(HDRP(bp), PACK(size, GET(HDRP(bp)) & (PREV_ALLOC | FRESH)));
+    PUT(FTRP(bp), PACK(size, 0));
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));   /* New epilogue header */
+    insert_free_block(bp, size);
+    return 1;
+}
+
+/*
+ * place - Place block of asize bytes at start of free block bp
+ *         and split if remainder would be at least minimum block size
+ */
+static void *place(void *bp, size_t asize)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    size_t fresh = IS_FRESH(bp);
     void *nxt = NULL;
     remove_free_block(bp);
 
+    /* A remainder keeps a fresh block's links or footer, so stays fresh */
     if ((csize - asize) >= (2*DSIZE)) {
-        if ((csize - asize) >= 200){
-            PUT(HDRP(bp), PACK(csize - asize, 0));
+        STAT(STATS.splits++);
+        if ((csize - asize) >= split_high){
+            PUT(HDRP(bp), PACK(csize - asize, prev_alloc | fresh));
             PUT(FTRP(bp), PACK(csize - asize, 0));
             nxt = NEXT_BLKP(bp);
             PUT(HDRP(nxt), PACK(asize, 1));
-            PUT(FTRP(nxt), PACK(asize, 1));
+            SET_PREV_ALLOC(NEXT_BLKP(nxt));
             insert_free_block(bp, csize - asize);
             return nxt;  
         }
-        else {
-            PUT(HDRP(bp), PACK(asize, 1));
-            PUT(FTRP(bp), PACK(asize, 1));
-            nxt = NEXT_BLKP(bp);
-            PUT(HDRP(nxt), PACK(csize-asize, 0));
-            PUT(FTRP(nxt), PACK(csize-asize, 0));
-            insert_free_block(nxt, csize - asize);
+        else {
+            PUT(HDRP(bp), PACK(asize, 1 | prev_alloc));
+            nxt = NEXT_BLKP(bp);
+            PUT(HDRP(nxt), PACK(csize-asize, PREV_ALLOC | fresh));
+            PUT(FTRP(nxt), PACK(csize-asize, 0));
+            insert_free_block(nxt, csize - asize);
+        }
+    }
+    else {
+        PUT(HDRP(bp), PACK(csize, 1 | prev_alloc));
+        SET_PREV_ALLOC(NEXT_BLKP(bp));
+    }
+    return bp;
+}
+
+/*
+ * alloc_aligned - Allocate a block of asize bytes whose payload is aligned
+ *                 to align bytes. The misaligned lead of the free block is
+ *                 split off as a free block of its own.
+ */
+static void *alloc_aligned(size_t align, size_t asize)
+{
+    size_t needed = asize + align + 2*DSIZE;
+    size_t csize, lead, prev_alloc, chunk;
+    char *bp, *abp, *nxt;
+
+    if ((bp = fit_block(needed)) == NULL) {
+        /* Grow only as far as an aligned payload at the arena's end needs,
+           and by the worst case if the arena had to start a new segment */
+        chunk = grow_chunk();
+        bp = arenap->heap_endp;
+        abp = ALIGN_PAYLOAD(bp, align);
+        if ((bp = extend_heap(MAX(abp - bp + asize, chunk)/WSIZE)) == NULL)
+            return NULL;
+        if (ALIGN_PAYLOAD(bp, align) + asize > bp + GET_SIZE(HDRP(bp)) &&
+            (bp = extend_heap(MAX(needed, chunk)/WSIZE)) == NULL)
+            return NULL;
+    }
+    remove_free_block(bp);
+    csize = GET_SIZE(HDRP(bp));
+    prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+
+    abp = ALIGN_PAYLOAD(bp, align);
+    lead = abp - bp;
+
+    if (lead) {
+        PUT(HDRP(bp), PACK(lead, prev_alloc));
+        PUT(FTRP(bp), PACK(lead, 0));
+        insert_free_block(bp, lead);
+        csize -= lead;
+        prev_alloc = 0;
+    }
+
+    if ((csize - asize) >= (2*DSIZE)) {
+        PUT(HDRP(abp), PACK(asize, 1 | prev_alloc));
+        nxt = NEXT_BLKP(abp);
+        PUT(HDRP(nxt), PACK(csize - asize, PREV_ALLOC));
+        PUT(FTRP(nxt), PACK(csize - asize, 0));
+        insert_free_block(nxt, csize - asize);
+    }
+    else {
+        PUT(HDRP(abp), PACK(csize, 1 | prev_alloc));
+        SET_PREV_ALLOC(NEXT_BLKP(abp));
+    }
+    return CHECK_BLOCK(abp);
+}
+
+/*
+ * slab_new_run - Carve a fresh run for slab class cls out of the heap
+ *                and make it the head of the class's partial list
+ */
+static void *slab_new_run(int cls)
+{
+    char *run;
+    int i, nobjs;
+
+    if ((run = alloc_aligned(RUN_SIZE, RUN_SIZE)) == NULL)
+        return NULL;
+    SET_SLAB(run);
+
+    RUN_OBJSIZE(run) = SLAB_OBJSIZE(cls);
+    nobjs = RUN_CAPACITY(run);
+    RUN_NFREE(run) = nobjs;
+    for (i = 0; i < RUN_MAP_WORDS; i++) {
+        RUN_MAP(run)[i] = 0;
+    }
+    for (i = 0; i < nobjs / 32; i++) {
+        RUN_MAP(run)[i] = ~0u;
+    }
+    if (nobjs % 32)
+        RUN_MAP(run)[i] = (1u << (nobjs % 32)) - 1;
+
+    PUT_PTR(RUN_NEXTP(run), NULL);
+    PUT_PTR(RUN_PREVP(run), NULL);
+    SLAB_LIST(cls) = run;
+    return run;
+}
+
+/*
+ * slab_unlink - Remove run from the partial list of slab class cls
+ */
+static void slab_unlink(char *run, int cls)
+{
+    if (RUN_PREV(run) != NULL)
+        PUT_PTR(RUN_NEXTP(RUN_PREV(run)), RUN_NEXT(run));
+    else
+        SLAB_LIST(cls) = RUN_NEXT(run);
+    if (RUN_NEXT(run) != NULL)
+        PUT_PTR(RUN_PREVP(RUN_NEXT(run)), RUN_PREV(run));
+}
+
+/*
+ * slab_malloc - Allocate a size-byte object from the first partial run of
+ *               its class, taking the lowest free slot in the run bitmap
+ */
+static void *slab_malloc(size_t size)
+{
+    int cls = SLAB_CLASS(size);
+    char *run = SLAB_LIST(cls);
+    unsigned int *map;
+    int i, bit;
+
+    if (run == NULL && (run = slab_new_run(cls)) == NULL)
+        return NULL;
+
+    map = RUN_MAP(run);
+    for (i = 0; map[i] == 0; i++)
+        ;
+    bit = __builtin_ctz(map[i]);
+    map[i] &= ~(1u << bit);
+
+    /* Full runs leave the partial list until an object comes back */
+    if (--RUN_NFREE(run) == 0)
+        slab_unlink(run, cls);
+
+    return run + RUN_HDR_SIZE + (i*32 + bit) * RUN_OBJSIZE(run);
+}
+
+/*
+ * slab_free - Return slab object bp to its run. A run that empties is
+ *             given back to the heap unless it is its class's only run.
+ */
+static void slab_free(void *bp)
+{
+    char *run = RUN_OF(bp);
+    int cls = SLAB_CLASS(RUN_OBJSIZE(run));
+    int index = ((char *)bp - run - RUN_HDR_SIZE) / RUN_OBJSIZE(run);
+
+    RUN_MAP(run)[index / 32] |= 1u << (index % 32);
+    RUN_NFREE(run)++;
+
+    if (RUN_NFREE(run) == 1) {
+        /* Was full: back on the partial list */
+        PUT_PTR(RUN_PREVP(run), NULL);
+        PUT_PTR(RUN_NEXTP(run), SLAB_LIST(cls));
+        if (SLAB_LIST(cls) != NULL)
+            PUT_PTR(RUN_PREVP(SLAB_LIST(cls)), run);
+        SLAB_LIST(cls) = run;
+    }
+    else if (RUN_NFREE(run) == RUN_CAPACITY(run) &&
+             (RUN_PREV(run) != NULL || RUN_NEXT(run) != NULL)) {
+        slab_unlink(run, cls);
+        CLEAR_SLAB(run);
+        heap_free(run);
+    }
+}
+
+/*
+ * usable_size - Payload bytes of allocated block, object or region bp.
+ *               A growing block's last word, its slack count, is not.
+ */
+static size_t usable_size(void *bp)
+{
+    if (IS_MAPPED(bp))
+        return MAP_SIZE(bp) - SIZE_T_SIZE;
+    if (IS_SLAB(bp))
+        return RUN_OBJSIZE(RUN_OF(bp));
+    return GET_SIZE(HDRP(bp)) - (IS_GROWING(bp) ? DSIZE : WSIZE);
+}
+
+/*
+ * map_malloc - Allocate a size-byte payload in a region of its own
+ */
+static void *map_malloc(size_t size)
+{
+    size_t msize = MAP_ROUND(size + SIZE_T_SIZE);
+    char *region;
+
+    LOCK_SBRK();
+    region = mem_map(msize);
+    UNLOCK_SBRK();
+    if (region == NULL)
+        return NULL;
+
+    *(size_t *)region = msize;
+    return region + SIZE_T_SIZE;
+}
+
+/*
+ * map_free - Unmap the region holding payload bp
+ */
+static void map_free(void *bp)
+{
+    LOCK_SBRK();
+    if (MAP_SIZE(bp) > GET_MAP_THRESHOLD() && MAP_SIZE(bp) <= MAP_THRESHOLD_MAX)
+        SET_MAP_THRESHOLD(MAP_SIZE(bp));
+    mem_unmap(MAP_REGION(bp));
+    UNLOCK_SBRK();
+}
+
+/*
+ * map_realloc - Resize ptr where it or size is mapped-sized: heap blocks
+ *               move to a region, regions are resized with mem_remap (so
+ *               the kernel moves pages rather than we copy bytes), and
+ *               regions shrinking below map_threshold move to the heap.
+ */
+static void *map_realloc(void *ptr, size_t size)
+{
+    size_t msize = MAP_ROUND(size + SIZE_T_SIZE);
+    char *region, *newptr;
+
+    if (!IS_MAPPED(ptr) || size < GET_MAP_THRESHOLD()) {
+        if ((newptr = mm_malloc(size)) == NULL)
+            return NULL;
+        memcpy(newptr, ptr, MIN(usable_size(ptr), size));
+        mm_free(ptr);
+        return newptr;
+    }
+
+    if (msize == MAP_SIZE(ptr))
+        return ptr;
+    LOCK_SBRK();
+    region = mem_remap(MAP_REGION(ptr), msize);
+    UNLOCK_SBRK();
+    if (region == NULL)
+        return NULL;
+
+    *(size_t *)region = msize;
+    return region + SIZE_T_SIZE;
+}
+
+#if THREAD_SAFE
+/*
+ * thread_arena - Return the calling thread's arena, assigning the next one
+ *                round robin on first use after mm_init
+ */
+static arena_t *thread_arena(void)
+{
+    if (thread_epoch != heap_epoch) {
+        home_arenap = arena_tablep +
+            __sync_fetch_and_add(&next_arena, 1) % NUM_ARENAS;
+        tcachep = NULL;
+        thread_epoch = heap_epoch;
+    }
+    return home_arenap;
+}
+
+/*
+ * arena_fallback - Return the arena to retry a failed request in after
+ *                  arena a: the next one round robin, or NULL once the
+ *                  thread's own arena comes round again. An arena fails
+ *                  only when the heap limit stops it growing, and a
+ *                  sibling may still have free blocks that fit.
+ */
+static arena_t *arena_fallback(arena_t *a)
+{
+    a = arena_tablep + (a - arena_tablep + 1) % NUM_ARENAS;
+    return a == thread_arena() ? NULL : a;
+}
+
+/*
+ * arena_lock - Lock arena a, make it the one heap routines work on, and
+ *              free the blocks other threads have queued for it
+ */
+static void arena_lock(arena_t *a)
+{
+    char *bp, *next;
+
+    pthread_mutex_lock(&a->lock);
+    arenap = a;
+
+    if (a->remote_freep == NULL)
+        return;
+    bp = __sync_lock_test_and_set(&a->remote_freep, NULL);
+    while (bp != NULL) {
+        next = GET_PTR(bp);
+        heap_free(bp);
+        bp = next;
+    }
+}
+
+/*
+ * remote_free - Push block bp onto the remote free queue of arena a, which
+ *               owns it, without taking a's lock. The queue is linked
+ *               through the blocks' payloads and taken whole by the next
+ *               thread to lock a.
+ */
+static void remote_free(arena_t *a, char *bp)
+{
+    char *head;
+
+    do {
+        head = a->remote_freep;
+        PUT_PTR(bp, head);
+    } while (!__sync_bool_compare_and_swap(&a->remote_freep, head, bp));
+}
+
+/*
+ * tcache_make_key - Create the key whose destructor flushes the cache of
+ *                   an exiting thread
+ */
+static void tcache_make_key(void)
+{
+    pthread_key_create(&tcache_key, tcache_release);
+}
+
+/*
+ * tcache_release - Give an exiting thread's cached objects, and the cache
+ *                  itself, back to the shared heap
+ */
+static void tcache_release(void *tc)
+{
+    arena_t *a;
+    int cls;
+
+    /* A cache from before the last mm_init went away with its heap */
+    if (tc != tcachep || thread_epoch != heap_epoch)
+        return;
+
+    for (cls = 0; cls < NUM_TCACHE_CLASSES; cls++) {
+        tcache_flush(tc, cls, TCACHE_COUNT(tc, cls));
+    }
+    a = ARENA_OF(tc);
+    arena_lock(a);
+    heap_free(tc);
+    UNLOCK_ARENA(a);
+    tcachep = NULL;
+}
+
+/*
+ * tcache_get - Return the calling thread's cache, creating it on first
+ *              use after mm_init. Returns NULL if the heap is exhausted.
+ */
+static char *tcache_get(void)
+{
+    arena_t *a = thread_arena();
+
+    if (tcachep != NULL)
+        return tcachep;
+
+    arena_lock(a);
+    tcachep = heap_malloc(TCACHE_SIZE);
+    UNLOCK_ARENA(a);
+    if (tcachep != NULL)
+        memset(tcachep, 0, TCACHE_SIZE);
+    pthread_setspecific(tcache_key, tcachep);
+    return tcachep;
+}
+
+/*
+ * tcache_class - Cache class of allocated object bp: the largest class
+ *                whose requests all fit in its payload (may be out of range).
+ *                Runs unlocked: other threads may flip bp's PREV_ALLOC bit
+ *                or other pages' run bits meanwhile, never what is read here.
+ */
+static int tcache_class(void *bp)
+{
+    return usable_size(bp) / TCACHE_QUANTUM - 1;
+}
+
+/*
+ * tcache_fill - Move up to TCACHE_BATCH new objects of class cls from the
+ *               thread's arena into cache tc
+ */
+static void tcache_fill(char *tc, int cls)
+{
+    arena_t *a = thread_arena();
+    char *bp;
+    int i;
+
+    arena_lock(a);
+    for (i = 0; i < TCACHE_BATCH; i++) {
+        if ((bp = heap_malloc(TCACHE_OBJSIZE(cls))) == NULL)
+            break;
+        PUT_PTR(bp, GET_PTR(TCACHE_HEAD(tc, cls)));
+        PUT_PTR(TCACHE_HEAD(tc, cls), bp);
+        TCACHE_COUNT(tc, cls)++;
+    }
+    UNLOCK_ARENA(a);
+}
+
+/*
+ * tcache_flush - Free the first n objects of class cls in cache tc: to the
+ *                thread's arena under one lock, and to other arenas through
+ *                their remote free queues
+ */
+static void tcache_flush(char *tc, int cls, int n)
+{
+    arena_t *a, *home = thread_arena();
+    int locked = 0;
+    char *bp;
+
+    while (n-- > 0) {
+        bp = GET_PTR(TCACHE_HEAD(tc, cls));
+        PUT_PTR(TCACHE_HEAD(tc, cls), GET_PTR(bp));
+        TCACHE_COUNT(tc, cls)--;
+        if ((a = ARENA_OF(bp)) != home) {
+            remote_free(a, bp);
+            continue;
+        }
+        if (!locked) {
+            arena_lock(home);
+            locked = 1;
         }
+        heap_free(bp);
+    }
+    if (locked)
+        UNLOCK_ARENA(home);
+}
+#endif /* THREAD_SAFE */
+
+#if USE_TLSF
+/*
+ * tlsf_mapping - Compute the TLSF list (fl, sl) holding blocks of size bytes
+ */
+static void tlsf_mapping(size_t size, int *fl, int *sl)
+{
+    int log2size;
+
+    if (size < TLSF_SMALL) {
+        *fl = 0;
+        *sl = size / DSIZE;
     }
     else {
-        PUT(HDRP(bp), PACK(csize, 1));
-        PUT(FTRP(bp), PACK(csize, 1));
+        log2size = 31 - __builtin_clz((unsigned int)size);
+        *fl = log2size - TLSF_FL_SHIFT + 1;
+        *sl = (size >> (log2size - TLSF_SL_LOG2)) - TLSF_SL_COUNT;
     }
-    return bp;
 }
 
 /*
- * find_fit - Find a fit for a block with asize bytes
+ * find_fit - Find a fit for a block with asize bytes in O(1): round asize
+ *            up to the next list boundary so that the head of any list at
+ *            or above it fits, then pick the first non-empty one.
  */
 static void *find_fit(size_t asize){
-    size_t size_check = asize;
-    void *curr = seg_listp;
-    int i = 0;
-
-    while (i < NUM_SEG_LISTS) {
-	
-        if ((i == NUM_SEG_LISTS - 1) || ((size_check <= 1) && (SEG_LIST(seg_listp, i)!= NULL))) {
-            curr  = SEG_LIST(seg_listp, i);
-
-            // locate the smallest block that can fit
-            while ((curr != NULL) && (asize > GET_SIZE(HDRP(curr)))){
-                curr = GET_PREV_BLK(curr);
+    int fl, sl;
+    unsigned int sl_map, fl_map;
+
+    if (asize >= TLSF_SMALL) {
+        if (asize > 0xffffffffu - (0xffffffffu >> TLSF_SL_LOG2))
+            return NULL;
+        asize += (1u << (31 - __builtin_clz((unsigned int)asize)
+                         - TLSF_SL_LOG2)) - 1;
+    }
+    tlsf_mapping(asize, &fl, &sl);
+
+    sl_map = TLSF_SL_MAP(fl) & (~0u << sl);
+    if (sl_map == 0) {
+        fl_map = arenap->seg_bitmap & (~0u << (fl + 1));
+        if (fl_map == 0)
+            return NULL;
+        fl = __builtin_ctz(fl_map);
+        sl_map = TLSF_SL_MAP(fl);
+    }
+    STAT(STAT_PROBES++);
+    return TLSF_LIST(fl, __builtin_ctz(sl_map));
+}
+
+/*
+ * insert_free_block - Push bp onto the head of its TLSF list
+ */
+static void insert_free_block(void *bp, size_t block_size){
+    void *head;
+    int fl, sl;
+
+    tlsf_mapping(block_size, &fl, &sl);
+    head = TLSF_LIST(fl, sl);
+    STAT(STATS.free_blocks[STAT_CLASS(block_size)]++);
+    STAT(STATS.free_bytes[STAT_CLASS(block_size)] += block_size);
+
+    PUT_PTR(GET_NEXT(bp), NULL);
+    PUT_PTR(GET_PREV(bp), head);
+    if (head != NULL)
+        PUT_PTR(GET_NEXT(head), bp);
+    TLSF_LIST(fl, sl) = bp;
+
+    TLSF_SL_MAP(fl) |= 1u << sl;
+    arenap->seg_bitmap |= 1u << fl;
+}
+
+/*
+ * remove_free_block - Unlink bp from its TLSF list
+ */
+static void remove_free_block(void *bp){
+    int fl, sl;
+
+    STAT(STATS.free_blocks[STAT_CLASS(GET_SIZE(HDRP(bp)))]--);
+    STAT(STATS.free_bytes[STAT_CLASS(GET_SIZE(HDRP(bp)))] -= GET_SIZE(HDRP(bp)));
+    if (GET_NEXT_BLK(bp) == NULL) {
+        tlsf_mapping(GET_SIZE(HDRP(bp)), &fl, &sl);
+        TLSF_LIST(fl, sl) = GET_PREV_BLK(bp);
+        if (TLSF_LIST(fl, sl) != NULL) {
+            PUT_PTR(GET_NEXT(TLSF_LIST(fl, sl)), NULL);
+        }
+        else {
+            TLSF_SL_MAP(fl) &= ~(1u << sl);
+            if (TLSF_SL_MAP(fl) == 0)
+                arenap->seg_bitmap &= ~(1u << fl);
+        }
+        return;
+    }
+
+    PUT_PTR(GET_PREV(GET_NEXT_BLK(bp)), GET_PREV_BLK(bp));
+    if (GET_PREV_BLK(bp) != NULL) {
+        PUT_PTR(GET_NEXT(GET_PREV_BLK(bp)), GET_NEXT_BLK(bp));
+    }
+}
+
+#else /* !USE_TLSF */
+
+/*
+ * tree_cmp - Compare the key (size, bp) against tree node node. A NULL
+ *            bp sorts before every block of the same size.
+ */
+static int tree_cmp(size_t size, void *bp, void *node)
+{
+    size_t node_size = GET_SIZE(HDRP(node));
+
+    if (size != node_size)
+        return (size < node_size) ? -1 : 1;
+    if (bp != node)
+        return ((char *)bp < (char *)node) ? -1 : 1;
+    return 0;
+}
+
+/*
+ * tree_splay - Top-down splay of the subtree at t around key (size, bp).
+ *              Returns the new subtree root: the node with that key if
+ *              there is one, else its predecessor or successor.
+ */
+static void *tree_splay(void *t, size_t size, void *bp)
+{
+    void *l = NULL, *r = NULL;        /* roots of the left and right trees */
+    void *lmax = NULL, *rmin = NULL;  /* where the next node is hung on each */
+    void *y;
+    int c;
+
+    if (t == NULL)
+        return NULL;
+
+    while ((c = tree_cmp(size, bp, t)) != 0) {
+        if (c < 0) {
+            if (TREE_LEFT(t) == NULL)
+                break;
+            if (tree_cmp(size, bp, TREE_LEFT(t)) < 0) {  /* rotate right */
+                y = TREE_LEFT(t);
+                SET_LEFT(t, TREE_RIGHT(y));
+                SET_RIGHT(y, t);
+                t = y;
+                if (TREE_LEFT(t) == NULL)
+                    break;
             }
-            if (curr != NULL) {
+            if (rmin == NULL)                            /* link right */
+                r = t;
+            else
+                SET_LEFT(rmin, t);
+            rmin = t;
+            t = TREE_LEFT(t);
+        }
+        else {
+            if (TREE_RIGHT(t) == NULL)
                 break;
+            if (tree_cmp(size, bp, TREE_RIGHT(t)) > 0) { /* rotate left */
+                y = TREE_RIGHT(t);
+                SET_RIGHT(t, TREE_LEFT(y));
+                SET_LEFT(y, t);
+                t = y;
+                if (TREE_RIGHT(t) == NULL)
+                    break;
             }
+            if (lmax == NULL)                            /* link left */
+                l = t;
+            else
+                SET_RIGHT(lmax, t);
+            lmax = t;
+            t = TREE_RIGHT(t);
         }
-        i++;
-        size_check = size_check >> 1;
     }
+
+    /* Reassemble */
+    if (lmax != NULL) {
+        SET_RIGHT(lmax, TREE_LEFT(t));
+        SET_LEFT(t, l);
+    }
+    if (rmin != NULL) {
+        SET_LEFT(rmin, TREE_RIGHT(t));
+        SET_RIGHT(t, r);
+    }
+    return t;
+}
+
 /*
-    for (i = 0; i < NUM_SEG_LISTS; i++) {
-      if ((i == NUM_SEG_LISTS - 1) || ((size_check <= 1) && (SEG_LIST(seg_listp, i) != NULL))) {
-        curr = SEG_LIST(seg_listp, i);
-        while ((curr != NULL) && asize > GET_SIZE(HDRP(curr))) {
-            curr = GET_PREV_BLK(curr);
+ * tree_insert - Add free block bp to the TREE_BIN splay tree
+ */
+static void tree_insert(void *bp, size_t size)
+{
+    void *root = SEG_LIST(arenap->seg_listp, TREE_BIN);
+
+    if (root == NULL) {
+        SET_LEFT(bp, NULL);
+        SET_RIGHT(bp, NULL);
+    }
+    else {
+        root = tree_splay(root, size, bp);
+        if (tree_cmp(size, bp, root) < 0) {
+            SET_LEFT(bp, TREE_LEFT(root));
+            SET_RIGHT(bp, root);
+            SET_LEFT(root, NULL);
         }
-        if (curr != NULL) {
-          break;
+        else {
+            SET_RIGHT(bp, TREE_RIGHT(root));
+            SET_LEFT(bp, root);
+            SET_RIGHT(root, NULL);
+        }
+    }
+    SEG_LIST(arenap->seg_listp, TREE_BIN) = bp;
+    arenap->seg_bitmap |= 1u << TREE_BIN;
+}
+
+/*
+ * tree_remove - Remove free block bp from the TREE_BIN splay tree
+ */
+static void tree_remove(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    void *root = tree_splay(SEG_LIST(arenap->seg_listp, TREE_BIN), size, bp);
+
+    /* bp is now the root; join its subtrees under the largest left node */
+    if (TREE_LEFT(root) == NULL) {
+        root = TREE_RIGHT(bp);
+    }
+    else {
+        root = tree_splay(TREE_LEFT(bp), size, bp);
+        SET_RIGHT(root, TREE_RIGHT(bp));
+    }
+    SEG_LIST(arenap->seg_listp, TREE_BIN) = root;
+    if (root == NULL)
+        arenap->seg_bitmap &= ~(1u << TREE_BIN);
+}
+
+/*
+ * tree_best_fit - Return the smallest block in the TREE_BIN splay tree
+ *                 with at least asize bytes, or NULL if there is none
+ */
+static void *tree_best_fit(size_t asize)
+{
+    void *root = tree_splay(SEG_LIST(arenap->seg_listp, TREE_BIN), asize, NULL);
+    void *curr;
+
+    STAT(STAT_PROBES++);
+    SEG_LIST(arenap->seg_listp, TREE_BIN) = root;
+    if (root == NULL || GET_SIZE(HDRP(root)) >= asize)
+        return root;
+
+    /* The root is the largest block below asize, so take its successor */
+    if ((curr = TREE_RIGHT(root)) != NULL) {
+        while (TREE_LEFT(curr) != NULL)
+            curr = TREE_LEFT(curr);
+    }
+    return curr;
+}
+
+/*
+ * list_fit - Return the first block of segregated list i, in list order,
+ *            with at least asize bytes, or NULL if there is none. Under
+ *            MM_FIT_NEXT the walk starts at the rover if it is in list i,
+ *            wraps around, and leaves the rover on the block it returns.
+ */
+static void *list_fit(int i, size_t asize)
+{
+    void *head = SEG_LIST(arenap->seg_listp, i);
+    void *start = head;
+    void *curr;
+
+    if (fit_policy == MM_FIT_NEXT && arenap->roverp != NULL &&
+        SEG_INDEX(GET_SIZE(HDRP(arenap->roverp))) == i)
+        start = arenap->roverp;
+
+    for (curr = start; curr != NULL; curr = GET_PREV_BLK(curr)) {
+        STAT(STAT_PROBES++);
+        if (GET_SIZE(HDRP(curr)) >= asize)
+            break;
+    }
+    if (curr == NULL) {
+        for (curr = head; curr != start; curr = GET_PREV_BLK(curr)) {
+            STAT(STAT_PROBES++);
+            if (GET_SIZE(HDRP(curr)) >= asize)
+                break;
         }
-      }
-      size_check = size_check >> 1;
+        if (curr == start)
+            curr = NULL;
     }
-    */
+    if (fit_policy == MM_FIT_NEXT && curr != NULL)
+        arenap->roverp = curr;
     return curr;
 }
 
+/*
+ * list_after - Nonzero iff free block bp, of size bytes, belongs after
+ *              node in its segregated list under fit_policy
+ */
+static int list_after(void *bp, size_t size, void *node)
+{
+    switch (fit_policy) {
+    case MM_FIT_BEST:
+        return size > GET_SIZE(HDRP(node));
+    case MM_FIT_ADDRESS:
+        return (char *)bp > (char *)node;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * find_fit - Find a fit for a block with asize bytes
+ */
+static void *find_fit(size_t asize){
+    int i = SEG_INDEX(asize);
+    unsigned int larger;
+    void *curr;
+
+    if (i == TREE_BIN)
+        return tree_best_fit(asize);
+
+    /* Blocks in asize's own list may still be too small, so walk it */
+    if (arenap->seg_bitmap & (1u << i)) {
+        if ((curr = list_fit(i, asize)) != NULL)
+            return curr;
+    }
+
+    /* Any block in a higher list fits, so search the first non-empty one */
+    larger = arenap->seg_bitmap & ~((2u << i) - 1);
+    if (larger == 0)
+        return NULL;
+    i = __builtin_ctz(larger);
+    if (i == TREE_BIN)
+        return tree_best_fit(asize);
+    return list_fit(i, asize);
+}
+
 static void insert_free_block(void *bp, size_t block_size){
     void *list_ptr = NULL;
     void *ins_loc = NULL;
-    int list_ind = 0;
+    int list_ind = SEG_INDEX(block_size);
 
-    // Find list for this block
-    while ((list_ind < (NUM_SEG_LISTS - 1)) && (block_size > 1)) {
-        block_size = block_size >> 1;
-        list_ind++;
+    STAT(STATS.free_blocks[STAT_CLASS(block_size)]++);
+    STAT(STATS.free_bytes[STAT_CLASS(block_size)] += block_size);
+    if (list_ind == TREE_BIN) {
+        tree_insert(bp, block_size);
+        return;
     }
 
-    list_ptr = SEG_LIST(seg_listp, list_ind);
+    list_ptr = SEG_LIST(arenap->seg_listp, list_ind);
+    arenap->seg_bitmap |= 1u << list_ind;
 
-    /* Find place to insert while maintaining sorting */
-    while ((list_ptr != NULL) && (block_size > GET_SIZE(HDRP(list_ptr)))) {
+    /* Find place to insert while maintaining the policy's order */
+    while ((list_ptr != NULL) && list_after(bp, block_size, list_ptr)) {
         ins_loc = list_ptr;
         list_ptr = GET_PREV_BLK(list_ptr);
     }
@@ -466,7 +2643,7 @@ static void insert_free_block(void *bp, size_t block_size){
             PUT_PTR(GET_NEXT(list_ptr), bp);
             PUT_PTR(GET_PREV(bp), list_ptr);
             PUT_PTR(GET_NEXT(bp), NULL);
-            SEG_LIST(seg_listp, list_ind) = bp;
+            SEG_LIST(arenap->seg_listp, list_ind) = bp;
         }
     }
 
@@ -477,7 +2654,7 @@ static void insert_free_block(void *bp, size_t block_size){
             PUT_PTR(GET_PREV(bp), NULL); 
         }
         else {
-            SEG_LIST(seg_listp, list_ind) = bp;
+            SEG_LIST(arenap->seg_listp, list_ind) = bp;
             PUT_PTR(GET_PREV(bp), NULL);
             PUT_PTR(GET_NEXT(bp), NULL);
         }
@@ -486,17 +2663,24 @@ static void insert_free_block(void *bp, size_t block_size){
 }
 
 static void remove_free_block(void *bp){
-    int list_num = 0;
-    size_t block_size = GET_SIZE(HDRP(bp));
+    int list_num = SEG_INDEX(GET_SIZE(HDRP(bp)));
+
+    STAT(STATS.free_blocks[STAT_CLASS(GET_SIZE(HDRP(bp)))]--);
+    STAT(STATS.free_bytes[STAT_CLASS(GET_SIZE(HDRP(bp)))] -= GET_SIZE(HDRP(bp)));
+    if (list_num == TREE_BIN) {
+        tree_remove(bp);
+        return;
+    }
+    if (bp == arenap->roverp)
+        arenap->roverp = GET_PREV_BLK(bp);
 
     if (GET_NEXT_BLK(bp) == NULL) {
-        while (list_num < (NUM_SEG_LISTS - 1) && block_size > 1) {
-            block_size = block_size >> 1;
-            list_num++;
+        SEG_LIST(arenap->seg_listp, list_num) = GET_PREV_BLK(bp);
+        if (SEG_LIST(arenap->seg_listp, list_num) != NULL) {
+            PUT_PTR(GET_NEXT(SEG_LIST(arenap->seg_listp, list_num)), NULL);
         }
-        SEG_LIST(seg_listp, list_num) = GET_PREV_BLK(bp);
-        if (SEG_LIST(seg_listp, list_num) != NULL) {
-            PUT_PTR(GET_NEXT(SEG_LIST(seg_listp, list_num)), NULL);
+        else {
+            arenap->seg_bitmap &= ~(1u << list_num);
         }
         return;
     }
@@ -506,84 +2690,457 @@ static void remove_free_block(void *bp){
     if (GET_PREV_BLK(bp) != NULL) {
         PUT_PTR(GET_NEXT(GET_PREV_BLK(bp)), GET_NEXT_BLK(bp));
     } 
-} /*
+}
+
+#endif /* USE_TLSF */
 
-static void checkblockfree(void *bp)
+/*
+ * Heap checker
+ */
+
+/* Nonzero iff p could be a payload address in the heap */
+#define IN_HEAP(p)  ((char *)(p) > heap_listp && (char *)(p) <= (char *)mem_heap_hi())
+
+#if CHECK_HEAP
+/*
+ * checkblock - The O(1) check CHECK_HEAP runs on a block an allocating
+ *              call returns or coalesce produces: abort unless it and its neighbors are
+ *              consistent. Returns bp.
+ */
+static void *checkblock(void *bp)
 {
-    if ((size_t)bp % 8)  //checks alignment
-        printf("Error: %p is not doubleword aligned\n", bp);
-        return 0;
-    if (GET(HDRP(bp)) != GET(FTRP(bp)))  //checks that sizes match both directions
-        printf("Error: header does not match footer\n");
-        return 0;
-    if (GET_ALLOC(bp) != 0) {
-      printf("Error: block in free list at %p is not marked free")
+    char *msg;
+
+    if (bp == NULL || IS_MAPPED(bp))
+        return bp;
+    if ((msg = blockerr(bp)) != NULL) {
+        fprintf(stderr, "Error: block %p %s\n", bp, msg);
+        abort();
     }
-    if (GET_ALLOC(HDRP(bp)) == 0) {  //specific to free blocks
-      if (GET_ALLOC(HDRP(GET(bp + WSIZE))) != 0) {  // check previous pointer points to free
-        printf("Error: %p did not assign previous properly\n", );
-        return 0;
-      }
-      if (GET_ALLOC(HDRP(GET(bp))) != 0) {  // check next pointer points to free
-        printf("Error: %p next does not point to a free block\n");
-        return 0;
-      }
+#if CHECK_HEAP > 1
+    if (!mm_checkheap(0))
+        abort();
+#endif
+    return bp;
+}
+
+/*
+ * checkfree - The O(1) check CHECK_HEAP runs on a block before freeing
+ *             it: abort if it is free already, or if it or a free
+ *             neighbor it may coalesce with is not a sound block. A block
+ *             waiting in a fast bin still looks allocated, so a second
+ *             free of it is caught only while it heads its bin.
+ */
+static void checkfree(void *bp)
+{
+    char *run;
+    int index;
+
+    if (IS_SLAB(bp)) {
+        run = RUN_OF(bp);
+        index = ((char *)bp - run - RUN_HDR_SIZE) / RUN_OBJSIZE(run);
+        if (runerr(run) == NULL && (RUN_MAP(run)[index / 32] & (1u << (index % 32)))) {
+            fprintf(stderr, "Error: object %p is freed twice\n", bp);
+            abort();
+        }
+    }
+    else if (!GET_ALLOC(HDRP(bp)) ||
+             (GET_SIZE(HDRP(bp)) <= FAST_MAX && FAST_BIN(GET_SIZE(HDRP(bp))) == bp)) {
+        fprintf(stderr, "Error: block %p is freed twice\n", bp);
+        abort();
     }
+    else {
+        if (!GET_ALLOC(HDRP(NEXT_BLKP(bp))))
+            checkblock(NEXT_BLKP(bp));
+        if (!GET_PREV_ALLOC(HDRP(bp)))
+            checkblock(PREV_BLKP(bp));
+    }
+    checkblock(bp);
 }
 
-static void checkblockall(void *curr, void *next)
+#endif /* CHECK_HEAP */
+
+/*
+ * blockerr - Check heap block or slab object bp against its header, its
+ *            neighbors and its free list links, in O(1). Returns what is
+ *            wrong, or NULL.
+ */
+static char *blockerr(void *bp)
 {
-    if ((size_t)curr % 8)  //checks alignment
-        printf("Error: %p is not doubleword aligned\n", bp);
-        return 0;
-    if (GET(HDRP(curr)) != GET(FTRP(curr)))  //checks that sizes match both directions
-        printf("Error: header does not match footer\n");
-        return 0;
-    if (GET_ALLOC(HDRP(curr)) == 0) {  //specific to free blocks
-      if (GET_ALLOC(HDRP(GET(bp + WSIZE))) != 0) {  // check previous pointer points to free
-        printf("Error: %p did not assign previous properly\n", );
-        return 0;
-      }
-      if (GET_ALLOC(HDRP(GET(bp))) != 0) {  // check next pointer points to free
-        printf("Error: %p next does not point to a free block\n");
-        return 0;
-      }
-      if(GET_ALLOC(HDRP(next)) == 0) {  //checks that no two free blocks are next to each other
-        printf("Error: two blocks did not coalesce correctly at %p");
-        return 0;
-      }
+    char *nxt, *prv, *run;
+    size_t size, psize;
+
+    if (!IN_HEAP(bp))
+        return "is outside the heap";
+    if (IS_SLAB(bp)) {
+        run = RUN_OF(bp);
+        if ((nxt = runerr(run)) != NULL)
+            return nxt;
+        if ((char *)bp != run) {
+            if ((char *)bp < run + RUN_HDR_SIZE ||
+                ((char *)bp - run - RUN_HDR_SIZE) % RUN_OBJSIZE(run) != 0)
+                return "is not an object of its run";
+            return NULL;
+        }
+    }
+
+    size = GET_SIZE(HDRP(bp));
+    if ((unsigned long)bp % ALIGNMENT != 0)
+        return "is misaligned";
+    if (size < 2*DSIZE || size % ALIGNMENT != 0)
+        return "has a bad size";
+    nxt = NEXT_BLKP(bp);
+    if (nxt > (char *)mem_heap_hi() + 1)
+        return "runs past the end of the heap";
+    if (!GET_PREV_ALLOC(HDRP(nxt)) != !GET_ALLOC(HDRP(bp)))
+        return "disagrees with the PREV_ALLOC bit of the block after it";
+
+    if (!GET_PREV_ALLOC(HDRP(bp))) {
+        psize = GET_SIZE((char *)bp - DSIZE);
+        prv = (char *)bp - psize;
+        if (psize < 2*DSIZE || !IN_HEAP(prv) || GET_SIZE(HDRP(prv)) != psize ||
+            GET_ALLOC(HDRP(prv)))
+            return "follows a free block whose footer and header disagree";
+        if (!GET_ALLOC(HDRP(bp)))
+            return "and the free block before it were not coalesced";
+    }
+
+    if (GET_ALLOC(HDRP(bp))) {
+        if (IS_GROWING(bp) && GET(FTRP(bp)) >= size)
+            return "records more slack than it holds";
+        return NULL;
     }
+    if (GET(FTRP(bp)) != PACK(size, 0))
+        return "has a footer that disagrees with its header";
+    if (!GET_ALLOC(HDRP(nxt)))
+        return "and the free block after it were not coalesced";
+    return linkerr(bp);
+}
+
+/*
+ * linkerr - Check that free block bp's list neighbors, or its list head,
+ *           point back at it. Tree nodes are left to mm_checkheap.
+ */
+static char *linkerr(void *bp)
+{
+    char *next = GET_NEXT_BLK(bp), *prev = GET_PREV_BLK(bp);
+    void *head;
+#if USE_TLSF
+    int fl, sl;
+
+    tlsf_mapping(GET_SIZE(HDRP(bp)), &fl, &sl);
+    head = TLSF_LIST(fl, sl);
+#else
+    int i = SEG_INDEX(GET_SIZE(HDRP(bp)));
+
+    if (i == TREE_BIN)
+        return NULL;
+    head = SEG_LIST(arenap->seg_listp, i);
+#endif
+
+    if (next == NULL ? head != bp : !IN_HEAP(next) || GET_PREV_BLK(next) != bp)
+        return "is not linked from the block before it in its free list";
+    if (prev != NULL && (!IN_HEAP(prev) || GET_NEXT_BLK(prev) != bp))
+        return "is not linked from the block after it in its free list";
+    return NULL;
+}
+
+/*
+ * runerr - Check the header of slab run run. Returns what is wrong, or NULL.
+ */
+static char *runerr(char *run)
+{
+    size_t objsize = RUN_OBJSIZE(run);
+    unsigned int nfree = 0;
+    int i;
+
+    if (objsize == 0 || objsize > SLAB_MAX || objsize % SLAB_QUANTUM != 0)
+        return "is in a run with a bad object size";
+    for (i = 0; i < RUN_MAP_WORDS; i++)
+        nfree += __builtin_popcount(RUN_MAP(run)[i]);
+    if (nfree != RUN_NFREE(run) || nfree > RUN_CAPACITY(run))
+        return "is in a run whose free count disagrees with its bitmap";
+    return NULL;
+}
+
+/*
+ * check_fail - Report what is wrong with block bp for mm_checkheap
+ */
+static void check_fail(void *bp, char *msg)
+{
+    if (bp != NULL)
+        fprintf(stderr, "Error: block %p %s\n", bp, msg);
+    else
+        fprintf(stderr, "Error: %s\n", msg);
+    check_errors++;
 }
 
+#if USE_TLSF
+/*
+ * check_index - Check arena a's TLSF lists and bitmaps, and that they hold
+ *               the nfree free blocks its segments do
+ */
+static void check_index(arena_t *a, size_t nfree)
+{
+    size_t count = 0;
+    int fl, sl, bfl, bsl;
+    char *bp, *next;
+
+    for (fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        if (!(a->seg_bitmap & (1u << fl)) != (TLSF_SL_MAP(fl) == 0))
+            check_fail(NULL, "first level bitmap disagrees with the second");
+        for (sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            if (!(TLSF_SL_MAP(fl) & (1u << sl)) != (TLSF_LIST(fl, sl) == NULL))
+                check_fail(NULL, "second level bitmap disagrees with its lists");
+            next = NULL;
+            for (bp = TLSF_LIST(fl, sl); bp != NULL && count <= nfree; bp = GET_PREV_BLK(bp)) {
+                count++;
+                if (!IN_HEAP(bp) || GET_ALLOC(HDRP(bp))) {
+                    check_fail(bp, "is in a free list but not free");
+                    break;
+                }
+                tlsf_mapping(GET_SIZE(HDRP(bp)), &bfl, &bsl);
+                if (bfl != fl || bsl != sl)
+                    check_fail(bp, "is in the wrong free list");
+                if (GET_NEXT_BLK(bp) != next)
+                    check_fail(bp, "has a bad back link in its free list");
+                next = bp;
+            }
+        }
+    }
+    if (count != nfree)
+        check_fail(NULL, "free index does not hold every free block once");
+}
+#else
 /*
- * checkheap - Minimal check of the heap for consistency
- *//*
-int checkheap(void)
+ * check_tree - Check the TREE_BIN subtree at t, whose keys must lie
+ *              strictly between those of nodes lo and hi (NULL: no bound).
+ *              Returns its node count, stopping past limit.
+ */
+static size_t check_tree(char *t, char *lo, char *hi, size_t limit)
 {
-    void *curr = heap_listp;  //points to current block
-    void *next = NULL; //points to next block
+    size_t count;
 
-    if ((GET_SIZE(HDRP(heap_listp)) != DSIZE) || !GET_ALLOC(HDRP(heap_listp)))
-        printf("Bad prologue header\n");  //make sure prologue is aligned and formatted
+    if (t == NULL || limit == 0)
         return 0;
-    checkblock(heap_listp);
+    if (!IN_HEAP(t) || GET_ALLOC(HDRP(t))) {
+        check_fail(t, "is in the free tree but not free");
+        return 1;
+    }
+    if (SEG_INDEX(GET_SIZE(HDRP(t))) != TREE_BIN)
+        check_fail(t, "is in the free tree but too small");
+    if ((lo != NULL && tree_cmp(GET_SIZE(HDRP(t)), t, lo) <= 0) ||
+        (hi != NULL && tree_cmp(GET_SIZE(HDRP(t)), t, hi) >= 0))
+        check_fail(t, "is out of order in the free tree");
+    count = 1 + check_tree(TREE_LEFT(t), lo, t, limit - 1);
+    return count + check_tree(TREE_RIGHT(t), t, hi, limit - count);
+}
+
+/*
+ * check_index - Check arena a's segregated lists, tree and bitmap, and
+ *               that they hold the nfree free blocks its segments do
+ */
+static void check_index(arena_t *a, size_t nfree)
+{
+    size_t count = 0;
+    char *bp, *next;
+    int i;
+
+    for (i = 0; i < TREE_BIN; i++) {
+        if (!(a->seg_bitmap & (1u << i)) != (SEG_LIST(a->seg_listp, i) == NULL))
+            check_fail(NULL, "list bitmap disagrees with the lists");
+        next = NULL;
+        for (bp = SEG_LIST(a->seg_listp, i); bp != NULL && count <= nfree; bp = GET_PREV_BLK(bp)) {
+            count++;
+            if (!IN_HEAP(bp) || GET_ALLOC(HDRP(bp))) {
+                check_fail(bp, "is in a free list but not free");
+                break;
+            }
+            if (SEG_INDEX(GET_SIZE(HDRP(bp))) != i)
+                check_fail(bp, "is in the wrong free list");
+            if (GET_NEXT_BLK(bp) != next)
+                check_fail(bp, "has a bad back link in its free list");
+            if (next != NULL && list_after(next, GET_SIZE(HDRP(next)), bp))
+                check_fail(bp, "is out of order in its free list");
+            next = bp;
+        }
+    }
+    if (!(a->seg_bitmap & (1u << TREE_BIN)) != (SEG_LIST(a->seg_listp, TREE_BIN) == NULL))
+        check_fail(NULL, "list bitmap disagrees with the tree");
+    count += check_tree(SEG_LIST(a->seg_listp, TREE_BIN), NULL, NULL, nfree + 1);
+    if (count != nfree)
+        check_fail(NULL, "free index does not hold every free block once");
+}
+#endif /* USE_TLSF */
 
-    for (int i = 0; i < NUM_SEG_LISTS; i++) {    //check every block in our free lists
-        curr = SEG_LIST(seg_listp, i);
-        while (curr != NULL) {
-          checkblockfree(curr);
-          curr = GET_PREV_BLK(curr);
+/*
+ * check_bins - Check arena a's fast bins and partial slab run lists
+ */
+static void check_bins(arena_t *a)
+{
+    size_t size, count = 0, limit = mem_heapsize() / (2*DSIZE);
+    char *bp, *run, *prev;
+    int cls;
+
+    for (size = 0; size <= FAST_MAX; size += ALIGNMENT) {
+        for (bp = SEG_LIST(a->fast_listp, size / ALIGNMENT); bp != NULL && count <= limit;
+             bp = GET_PTR(bp)) {
+            count++;
+            if (!IN_HEAP(bp) || ARENA_OF(bp) != a) {
+                check_fail(bp, "is in a fast bin but not in its arena");
+                break;
+            }
+            if (!GET_ALLOC(HDRP(bp)) || GET_SIZE(HDRP(bp)) != size)
+                check_fail(bp, "is in the wrong fast bin");
+        }
+    }
+    if (count != a->fast_count)
+        check_fail(NULL, "fast bins disagree with their count");
+
+    for (cls = 0; cls < NUM_SLAB_CLASSES; cls++) {
+        prev = NULL;
+        count = 0;
+        for (run = SEG_LIST(a->slab_listp, cls); run != NULL && count++ <= limit;
+             run = RUN_NEXT(run)) {
+            if (!IN_HEAP(run) || !IS_SLAB(run) || runerr(run) != NULL) {
+                check_fail(run, "is in a slab list but not a sound run");
+                break;
+            }
+            if (RUN_OBJSIZE(run) != SLAB_OBJSIZE(cls) || RUN_NFREE(run) == 0)
+                check_fail(run, "is in the wrong slab list");
+            if (RUN_PREV(run) != prev)
+                check_fail(run, "has a bad back link in its slab list");
+            prev = run;
         }
     }
+}
+
+#if TRACE_EVENTS
+/*
+ * Event tracing
+ */
+#undef mm_malloc
+#undef mm_calloc
+#undef mm_free
+#undef mm_realloc
+#undef mm_malloc_batch
+#undef mm_memalign
+#undef mm_posix_memalign
+
+/*
+ * trace_record - Record an event in the next slot of the ring, overwriting
+ *                the oldest. A call that may free a block records that
+ *                before it runs, and a call that returns one after, so
+ *                another thread's reuse of a block is always ordered
+ *                after its release.
+ */
+static void trace_record(int op, void *addr, void *old, size_t size)
+{
+    mm_event_t *ev;
+
+#if THREAD_SAFE
+    ev = trace_ring + (__sync_fetch_and_add(&trace_count, 1) & (TRACE_EVENTS - 1));
+#else
+    ev = trace_ring + (trace_count++ & (TRACE_EVENTS - 1));
+#endif
+    ev->cycles = TRACE_CYCLES();
+    ev->addr = (unsigned long)addr;
+    ev->old = (unsigned long)old;
+    ev->size = size;
+    ev->bin = trace_bin;
+    ev->op = op;
+}
+
+/*
+ * mm_malloc - Traced: record the block returned
+ */
+void *mm_malloc(size_t size)
+{
+    void *bp;
+
+    trace_bin = -1;
+    bp = untraced_malloc(size);
+    trace_record(MM_EV_ALLOC, bp, NULL, size);
+    return bp;
+}
+
+/*
+ * mm_calloc - Traced as a malloc of the same bytes, which replays alike
+ */
+void *mm_calloc(size_t nmemb, size_t size)
+{
+    void *bp;
 
-    for (curr = heap_listp; GET_SIZE(HDRP(curr)) > 0; curr = NEXT_BLKP(curr)) {
-        next = NEXT_BLKP(curr);
-        checkblockall(curr, next);
+    trace_bin = -1;
+    bp = untraced_calloc(nmemb, size);
+    trace_record(MM_EV_ALLOC, bp, NULL, nmemb * size);
+    return bp;
+}
+
+/*
+ * mm_malloc_batch - Traced as a malloc per block
+ */
+int mm_malloc_batch(size_t n, size_t sizes[], void *out[])
+{
+    size_t i;
+    int ret;
+
+    trace_bin = -1;
+    if ((ret = untraced_malloc_batch(n, sizes, out)) == 0) {
+        for (i = 0; i < n; i++) {
+            if (out[i] != NULL)
+                trace_record(MM_EV_ALLOC, out[i], NULL, sizes[i]);
+        }
     }
+    return ret;
+}
 
-    if ((GET_SIZE(HDRP(bp)) != 0) || !(GET_ALLOC(HDRP(bp))))
-        printf("Bad epilogue header\n");  //make sure epilogue is aligned and formatted
-        return 0;
-    return 1
+/*
+ * mm_memalign - Traced as a malloc, as is mm_posix_memalign
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+    void *bp;
+
+    trace_bin = -1;
+    bp = untraced_memalign(alignment, size);
+    trace_record(MM_EV_ALLOC, bp, NULL, size);
+    return bp;
+}
+
+int mm_posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    int ret;
+
+    trace_bin = -1;
+    if ((ret = untraced_posix_memalign(memptr, alignment, size)) == 0)
+        trace_record(MM_EV_ALLOC, *memptr, NULL, size);
+    return ret;
+}
+
+/*
+ * mm_free - Traced: record the block freed
+ */
+void mm_free(void *bp)
+{
+    trace_bin = -1;
+    trace_record(MM_EV_FREE, bp, NULL, 0);
+    untraced_free(bp);
+}
+
+/*
+ * mm_realloc - Traced: record the release of the old block, then where
+ *              it went
+ */
+void *mm_realloc(void *ptr, size_t size)
+{
+    void *bp;
+
+    trace_bin = -1;
+    if (ptr != NULL)
+        trace_record(MM_EV_RELEASE, NULL, ptr, size);
+    bp = untraced_realloc(ptr, size);
+    trace_record(MM_EV_REALLOC, bp, ptr, size);
+    return bp;
 }
-*/
\ No newline at end of file
+#endif /* TRACE_EVENTS */
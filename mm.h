@@ -1,9 +1,78 @@
 #include <stdio.h>
+#include <stdint.h>
 
 extern int mm_init (void);
 extern void *mm_malloc (size_t size);
+extern void *mm_calloc (size_t nmemb, size_t size);
+extern int mm_malloc_batch(size_t n, size_t sizes[], void *out[]);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern int mm_posix_memalign(void **memptr, size_t alignment, size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
+extern int mm_trim(size_t pad);
+extern size_t mm_usable_size(void *ptr);
+extern size_t mm_try_expand(void *ptr, size_t min, size_t max);
+extern size_t mm_grow_slack(void);
+extern int mm_checkheap(int verbose);
+
+/* Parameters for mm_setopt */
+#define MM_GROW_MIN    1  /* smallest heap extension (bytes) */
+#define MM_GROW_MAX    2  /* largest extension a burst of misses grows to */
+#define MM_GROW_BURST  3  /* misses this many allocations apart are a burst */
+#define MM_FIT_POLICY  4  /* free block placement, an MM_FIT_ value */
+#define MM_SPLIT_HIGH  5  /* allocate at a free block's high end if this
+                             many bytes or more remain */
+#define MM_HEAP_MAX    6  /* bytes of address space mm_init reserves for
+                             the heap (0: as memlib has it) */
+
+/* Values of MM_FIT_POLICY */
+#define MM_FIT_BEST     0  /* smallest fit in the segregated lists */
+#define MM_FIT_FIRST    1  /* first fit in LIFO lists */
+#define MM_FIT_NEXT     2  /* first fit after the last one found */
+#define MM_FIT_ADDRESS  3  /* lowest-addressed fit */
+extern int mm_setopt(int param, size_t value);
+
+/* Allocator counters, kept in builds with COLLECT_STATS=1 */
+#define MM_STATS_CLASSES  15  /* class i: free blocks of 2^i bytes up, the last 2^14 up */
+#define MM_STATS_PROBES   16  /* bucket i: fit searches probing 2^(i-1) to 2^i - 1 blocks */
+typedef struct {
+    size_t free_blocks[MM_STATS_CLASSES]; /* free blocks in each size class */
+    size_t free_bytes[MM_STATS_CLASSES];  /* and the bytes they hold */
+    size_t fast_blocks;       /* freed blocks waiting in the fast bins */
+    size_t fit_probes[MM_STATS_PROBES];   /* fit searches by free blocks probed */
+    size_t fit_misses;        /* fit searches that found nothing */
+    size_t splits;            /* placements that split off a free block */
+    size_t coalesce[4];       /* coalesce calls by case: neither, next, previous, both neighbors free */
+    size_t extend_calls;      /* heap extensions */
+    size_t extend_bytes;      /* bytes they added */
+    size_t realloc_inplace;   /* heap reallocs that kept the block */
+    size_t realloc_copies;    /* heap reallocs that moved it */
+} mm_stats_t;
+extern int mm_stats(mm_stats_t *stats);
+
+/* Allocator event trace, kept in builds with TRACE_EVENTS=n */
+#define MM_EV_ALLOC    'a'  /* an allocating call returned addr */
+#define MM_EV_FREE     'f'  /* mm_free was given addr */
+#define MM_EV_RELEASE  'R'  /* mm_realloc was given old, and may free it */
+#define MM_EV_REALLOC  'r'  /* mm_realloc moved old to addr */
+typedef struct {
+    uint64_t cycles;          /* cycle counter when the call returned, or
+                                 (MM_EV_FREE, MM_EV_RELEASE) was entered */
+    uint64_t addr;            /* block returned or freed (0: none) */
+    uint64_t old;             /* block mm_realloc was given */
+    uint64_t size;            /* bytes asked for */
+    int32_t bin;              /* free list find_fit took the block from, or -1 */
+    uint8_t op;               /* an MM_EV_ value */
+    uint8_t pad[3];
+} mm_event_t;
+
+/* mm_trace_dump writes this, then count mm_event_ts oldest first */
+#define MM_TRACE_MAGIC  "MMEV"
+typedef struct {
+    char magic[4];
+    uint32_t count;
+} mm_trace_hdr_t;
+extern int mm_trace_dump(FILE *fp);
 
 
 /* 
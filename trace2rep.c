@@ -0,0 +1,185 @@
+/*
+ * trace2rep.c - Convert an event trace written by mm_trace_dump (in a
+ *               build with TRACE_EVENTS=n) to a .rep tracefile that
+ *               mdriver can replay:
+ *
+ *      unix> trace2rep events.bin > events.rep
+ *      unix> mdriver -V -f events.rep
+ *
+ *      Each block gets an id when it is allocated and keeps it through
+ *      reallocs. Calls that returned or freed nothing are dropped, as
+ *      are frees of blocks allocated before the oldest event the ring
+ *      kept; a realloc of such a block becomes an allocation.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mm.h"
+
+/* Address to block id table, open addressing with linear probing. A
+   slot keeps its address once used, so lookups never need tombstones. */
+typedef struct {
+    uint64_t addr;            /* 0: slot never used */
+    int id;                   /* live block at addr, or -1 */
+    int moving;               /* 1 + id of the block an unfinished
+                                 mm_realloc has taken from addr, or 0 */
+} slot_t;
+
+static slot_t *table;
+static size_t table_mask;
+
+/*
+ * lookup - Return the slot for addr, which is either the one holding it
+ *          or the empty one it would go in
+ */
+static slot_t *lookup(uint64_t addr)
+{
+    size_t i = (addr >> 3) * 0x9e3779b97f4a7c15ull & table_mask;
+
+    while (table[i].addr != 0 && table[i].addr != addr)
+        i = (i + 1) & table_mask;
+    return &table[i];
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: trace2rep <event dump> [<out.rep>]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in, *out = stdout;
+    mm_trace_hdr_t hdr;
+    mm_event_t *ev;
+    char *ops;
+    slot_t *s;
+    size_t i, len = 0, cap, live = 0, peak = 0, *sizes;
+    int num_ids = 0, num_ops = 0, id;
+
+    if (argc < 2 || argc > 3)
+        usage();
+    if ((in = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        exit(1);
+    }
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 ||
+        memcmp(hdr.magic, MM_TRACE_MAGIC, sizeof(hdr.magic)) != 0) {
+        fprintf(stderr, "%s: not an mm_trace_dump file\n", argv[1]);
+        exit(1);
+    }
+    if ((ev = malloc(hdr.count * sizeof(mm_event_t) + 1)) == NULL ||
+        fread(ev, sizeof(mm_event_t), hdr.count, in) != hdr.count) {
+        fprintf(stderr, "%s: truncated after %u events\n", argv[1], hdr.count);
+        exit(1);
+    }
+    fclose(in);
+
+    /* Each event has at most two addresses, so this keeps the table half empty */
+    for (table_mask = 1; table_mask < 4 * (size_t)hdr.count; table_mask <<= 1)
+        ;
+    table = calloc(table_mask, sizeof(slot_t));
+    table_mask--;
+    sizes = malloc((hdr.count + 1) * sizeof(size_t));
+    cap = 48 * (size_t)hdr.count + 1;
+    ops = malloc(cap);
+    if (table == NULL || sizes == NULL || ops == NULL) {
+        fprintf(stderr, "trace2rep: out of memory\n");
+        exit(1);
+    }
+
+    /* The header needs the op and id counts, so buffer the ops */
+    for (i = 0; i < hdr.count; i++) {
+        switch (ev[i].op) {
+        case MM_EV_ALLOC:
+            if (ev[i].addr == 0)
+                continue;
+            s = lookup(ev[i].addr);
+            s->addr = ev[i].addr;
+            s->id = id = num_ids++;
+            sizes[id] = ev[i].size;
+            live += ev[i].size;
+            len += sprintf(ops + len, "a %d %lu\n", id, (unsigned long)ev[i].size);
+            break;
+
+        case MM_EV_FREE:
+            if (ev[i].addr == 0 || (s = lookup(ev[i].addr))->addr == 0 || s->id < 0)
+                continue;
+            live -= sizes[s->id];
+            len += sprintf(ops + len, "f %d\n", s->id);
+            s->id = -1;
+            break;
+
+        case MM_EV_RELEASE:
+            /* Another thread may be handed the address before the
+               realloc returns, so hold the id aside until it does */
+            if (ev[i].old == 0 || (s = lookup(ev[i].old))->addr == 0 || s->id < 0)
+                continue;
+            s->moving = s->id + 1;
+            s->id = -1;
+            continue;
+
+        case MM_EV_REALLOC:
+            id = -1;
+            s = ev[i].old == 0 ? NULL : lookup(ev[i].old);
+            if (s != NULL && s->addr != 0 && s->moving != 0) {
+                id = s->moving - 1;
+                s->moving = 0;
+            }
+            else if (s != NULL && s->addr != 0 && s->id >= 0) {
+                /* The MM_EV_RELEASE fell out of the ring */
+                id = s->id;
+                s->id = -1;
+            }
+
+            /* A NULL result with a size left the block where it was */
+            if (ev[i].addr == 0 && ev[i].size != 0) {
+                if (id >= 0)
+                    s->id = id;
+                continue;
+            }
+            if (id >= 0) {
+                live -= sizes[id];
+                if (ev[i].addr == 0) {
+                    len += sprintf(ops + len, "f %d\n", id);
+                    break;
+                }
+                len += sprintf(ops + len, "r %d %lu\n", id, (unsigned long)ev[i].size);
+            }
+            else if (ev[i].addr != 0) {
+                id = num_ids++;
+                len += sprintf(ops + len, "a %d %lu\n", id, (unsigned long)ev[i].size);
+            }
+            else
+                continue;
+            s = lookup(ev[i].addr);
+            s->addr = ev[i].addr;
+            s->id = id;
+            sizes[id] = ev[i].size;
+            live += ev[i].size;
+            break;
+
+        default:
+            fprintf(stderr, "%s: bad event type %d\n", argv[1], ev[i].op);
+            exit(1);
+        }
+        num_ops++;
+        peak = live > peak ? live : peak;
+    }
+
+    if (argc == 3 && (out = fopen(argv[2], "w")) == NULL) {
+        perror(argv[2]);
+        exit(1);
+    }
+    fprintf(out, "%lu\n%d\n%d\n%d\n", (unsigned long)peak, num_ids, num_ops, 1);
+    fwrite(ops, 1, len, out);
+    if (fclose(out) != 0) {
+        perror("trace2rep");
+        exit(1);
+    }
+    return 0;
+}